@@ -8,12 +8,45 @@
 #include <sstream>
 #include <iostream>
 #include <fstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#include "core/RingBuffer.hpp"
+#include "core/FramePool.hpp"
+#include "core/AllocationCounter.hpp"
+#include "core/FrameSource.hpp"
+#include "core/FrameBudget.hpp"
+#include "core/SessionFile.hpp"
+#include "core/DetectionPublisher.hpp"
+#include "core/LatencyStats.hpp"
+#include "core/CalibrationFile.hpp"
+#include "core/CameraIntrinsics.hpp"
+#include "core/MarkerDrawing.hpp"
+#include "core/MarkerDetection.hpp"
+#include "core/MarkerPose.hpp"
+#include "core/MarkerTracker.hpp"
+#include "core/ObjectTracker.hpp"
+#include "core/Trace.hpp"
 
 using namespace std;
 using namespace cv;
 
 const float arucoSquareDimension = 0.0382f;         // Dimension of side of one aruco square [m]
-const Size chessboardDimensions = Size(4, 8);       // Number of square on Chessboard calibration page
+const size_t stageQueueCapacity = 4;                // Frames that can wait between two pipeline stages before the oldest one is dropped
+const size_t maxMarkersPerFrame = 50;               // Every marker of the 4x4_50 dictionary, buffers are reserved for that many
+const int allocationWarmupFrames = 30;              // Frames before the allocation counts start, while buffers settle
+
+atomic<bool> interruptRequested(false);             // Ctrl-C: stop reading frames, finish the ones in flight and print the statistics
+
+void requestInterrupt(int) {
+    interruptRequested.store(true);
+}
 
 void createArucoMarkers() {                                             // Function to create the Aruco markers for us and put them in the "markers" directory
 
@@ -36,182 +69,612 @@ void createArucoMarkers() {                                             // Funct
 
 }
 
-void inverseOfCameraMatrix(const Mat& cameraMatrix, Mat inverseCameraMatrix) {  // Function to calculate inverse of camera matrix (specific to 3x3 upper traignel matrices)
-    inverseCameraMatrix = Mat::zeros(3, 3, CV_64F);
+struct FrameBuffers {                                                   // Storage for one frame, taken from the frame pool and reused
+    Mat frame;
+    vector<int> markerIDs;
+    vector<vector<Point2f>> markerCorners;
+    vector<Vec3d> rotationVectors, translationVectors;
+};
+
+struct FramePacket {                                                    // Everything that travels down the pipeline for one frame
+    int index = -1;                                                     // Position of the frame in the video
+    chrono::steady_clock::time_point captureTime;                       // When the frame came out of the decoder (when the sensor took it, for a live camera)
+    double timestampMilliseconds = 0.0;                                 // Capture time given by the frame source (media time, or the recorded time when replaying)
+    QualityLevel quality = QUALITY_FULL;                                // How much of the processing the frame budget allows for this frame
+    chrono::steady_clock::duration work{};                              // Time spent on the frame by detection, pose, tracking and display (decoding is not counted, a live camera spends it waiting)
+    FrameRef<FrameBuffers> buffers;                                     // Goes back to the pool when the packet is shown or dropped
+};
+
+enum DisplayMode {
+    DISPLAY_FULL,                                                       // Overlays drawn on every frame, shown at full size
+    DISPLAY_PREVIEW,                                                    // Overlays drawn on a downscaled copy a few times per second, on their own thread
+    DISPLAY_HEADLESS                                                    // Nothing drawn and no window
+};
+
+struct MonitoringOptions {                                              // How startCameraMonitoring runs
+    string videoPath;                                                   // Camera index, video or recorded session
+    bool realtime = false;                                              // Replay a session at its recorded pace instead of as fast as possible
+    LiveCameraSettings camera;                                          // Used when videoPath is a camera index (or a stand-in)
+    string recordPath;                                                  // Record the frames and detections of this run, if set
+    SessionCompression recordCompression = SESSION_RAW;
+    string publishName;                                                 // Shared memory stream the detections are published to, if set
+    int detectionWorkers = 1;
+    ostream* poseStream = nullptr;                                      // Where the marker poses are streamed, if anywhere
+    bool trackMarkers = false;                                          // Only search around the previous detections
+    int fullSearchInterval = 15;                                        // Frames between two full-frame searches when tracking
+    bool trackObjects = false;                                          // Follow the 3D marker positions across frames (Kalman filtered tracks)
+    DetectorConfig detector;                                            // Detector parameters and pyramid level
+    DisplayMode display = DISPLAY_FULL;
+    double previewScale = 0.5;                                          // Size of the preview relative to the frame
+    double previewRate = 10.0;                                          // Previews per second
+    double budgetMilliseconds = 0.0;                                    // Work allowed per frame before the quality is lowered (0 = always full quality)
+};
+
+struct PipelineStats {                                                  // Latency and heap allocations of every stage of the pipeline
+    LatencyHistogram decode, detection, pose, tracking, display, preview, endToEnd;
+    LatencyHistogram glassToDetection;                                  // Sensor to detection result, live cameras only
+    AllocationStats decodeAllocations, detectionAllocations, poseAllocations, displayAllocations;
+    int comparedFrames = 0, differingFrames = 0;                        // Detections checked against a replayed session (pose thread only)
+    int tracksStarted = 0;                                              // Object tracks created, more than the markers seen means tracks were lost
+};
+
+bool sameDetections(const SessionDetections& recorded, const vector<int>& markerIDs, const vector<vector<Point2f>>& markerCorners) {  // Same markers, same corners, as in the recording
+
+    const float cornerTolerance = 1e-3f;                                // [px], replays are bit-identical, this only absorbs float printing
+    if (recorded.markerIDs != markerIDs) {
+        return false;
+    }
+    for (size_t i = 0; i < markerIDs.size(); i++) {
+        for (size_t c = 0; c < 4; c++) {
+            Point2f difference = recorded.markerCorners[i][c] - markerCorners[i][c];
+            if (fabs(difference.x) > cornerTolerance || fabs(difference.y) > cornerTolerance) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
 
-    double a = cameraMatrix.at<double>(0, 0);
-    double b = cameraMatrix.at<double>(0, 1);
-    double c = cameraMatrix.at<double>(0, 2);
-    double d = cameraMatrix.at<double>(1, 1);
-    double e = cameraMatrix.at<double>(1, 2);
-    double f = cameraMatrix.at<double>(2, 2);
+void closeWhenLastWorker(atomic<int>& activeWorkers, RingBuffer<FramePacket>& output) {    // The last worker of a stage to finish closes the queue behind it
+    if (activeWorkers.fetch_sub(1) == 1) {
+        output.close();
+    }
+}
 
-    inverseCameraMatrix.at<double>(0, 0) = 1/a;
-    inverseCameraMatrix.at<double>(0, 1) = -b/(a*d);
-    inverseCameraMatrix.at<double>(0, 2) = (b*e - c*d)/(a*f*d);
-    inverseCameraMatrix.at<double>(1, 1) = 1/d;
-    inverseCameraMatrix.at<double>(1, 2) = -e/(f*d);
-    inverseCameraMatrix.at<double>(2, 2) = 1/f;
+void printPipelineStats(const PipelineStats& stats, const RingBuffer<FramePacket>& detectQueue, const RingBuffer<FramePacket>& poseQueue, const RingBuffer<FramePacket>& displayQueue, const FramePool<FrameBuffers>& framePool, const FrameBudgetScheduler* scheduler) {
 
-}
+    struct Row { const char* name; const LatencyHistogram& latency; };
+    const Row rows[] = {{"decode", stats.decode}, {"detection", stats.detection}, {"pose", stats.pose}, {"tracking", stats.tracking}, {"display", stats.display}, {"preview", stats.preview}, {"end to end", stats.endToEnd}, {"glass to detection", stats.glassToDetection}};
 
-void drawDetectedMarkerAxis(InputOutputArray _image, InputArrayOfArrays _corners, InputArray _ids, const Mat& cameraMatrix, bool showID = false) {
-
-    CV_Assert(_image.getMat().total() != 0 && (_image.getMat().channels() == 1 || _image.getMat().channels() == 3));
-    CV_Assert((_corners.total() == _ids.total()) || _ids.total() == 0);
-
-    int nMarkers = (int)_corners.total();
-    for(int i = 0; i < nMarkers; i++) {
-        Mat currentMarker = _corners.getMat(i);
-        CV_Assert(currentMarker.total() == 4 && currentMarker.type() == CV_32FC2);
-
-        // Draw marker axis
-        Point2f originPoint, xPoint, yPoint, zPoint;
-        originPoint = currentMarker.ptr< Point2f >(0)[2];
-        xPoint = currentMarker.ptr< Point2f >(0)[1];
-        yPoint = currentMarker.ptr< Point2f >(0)[3];
-        Point2f translation;
-        translation = 0.5*(xPoint - originPoint) + 0.5*(yPoint - originPoint);
-
-        line(_image, originPoint + translation, xPoint + translation, cv::Scalar(0, 0, 255), 1, 8, 0);
-        line(_image, originPoint + translation, yPoint + translation, cv::Scalar(0, 255, 0), 1, 8, 0);
-
-        Mat inverseCameraMatrix;
-        inverseOfCameraMatrix(cameraMatrix, inverseCameraMatrix);
-
-        // Draw first corner mark
-        rectangle(_image, currentMarker.ptr< Point2f >(0)[2] - Point2f(3, 3) + translation, currentMarker.ptr< Point2f >(0)[2] + Point2f(3, 3) + translation, cv::Scalar(255, 255, 255), 1, LINE_AA);
-
-        // Show ID number (if requested)
-        if (showID) {
-            
-            if(_ids.total() != 0) {
-                
-                Point2f cent(0, 0);
-                for(int p = 0; p < 4; p++)
-                    cent += currentMarker.ptr< Point2f >(0)[p];
-                cent = cent / 4.;
-                stringstream s;
-                s << "id=" << _ids.getMat().ptr< int >(0)[i];
-                putText(_image, s.str(), cent, FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 255), 2);
-            }
+    cout << endl << "Stage latencies:" << endl;
+    for (const Row& row : rows) {
+        if (row.latency.count() == 0) {                                 // Glass to detection only exists for live cameras, preview in preview mode, tracking with --object-tracks
+            continue;
         }
+        cout << "   " << row.name << ": " << row.latency.count() << " frames, p50 " << row.latency.percentileMilliseconds(0.5) << " ms, p99 " << row.latency.percentileMilliseconds(0.99) << " ms, max " << row.latency.maxMilliseconds() << " ms" << endl;
+    }
+    cout << "Frames dropped before detection: " << detectQueue.dropped() << ", before pose: " << poseQueue.dropped() << ", before display: " << displayQueue.dropped() << endl;
+
+    struct AllocationRow { const char* name; const AllocationStats& allocations; };
+    const AllocationRow allocationRows[] = {{"decode", stats.decodeAllocations}, {"detection", stats.detectionAllocations}, {"pose", stats.poseAllocations}, {"display", stats.displayAllocations}};
+
+    cout << "Heap allocations after " << allocationWarmupFrames << " warm-up frames:" << endl;
+    for (const AllocationRow& row : allocationRows) {
+        cout << "   " << row.name << ": " << row.allocations.perFrame() << " per frame, " << row.allocations.allocatingFrames() << " of " << row.allocations.frames() << " frames allocated" << endl;
+    }
+    cout << "Decoder waited for a free frame buffer " << framePool.exhausted() << " times (" << framePool.capacity() << " buffers)" << endl;
+
+    if (scheduler != nullptr) {
+        printFrameBudgetReport(cout, *scheduler);
+    }
+    if (stats.tracksStarted > 0) {
+        cout << "Object tracks started: " << stats.tracksStarted << endl;
+    }
+    if (stats.comparedFrames > 0) {
+        cout << "Detections differing from the recorded session: " << stats.differingFrames << " of " << stats.comparedFrames << " frames" << endl;
     }
 }
 
-int startCameraMonitoring(const Mat& cameraMatrix, const Mat& distortionCoefficients, float arucoSquareDimension) { // Function find aruco codes in video
+int startCameraMonitoring(const CameraIntrinsics& intrinsics, const Mat& distortionCoefficients, const CornerUndistorter& cornerUndistorter, float arucoSquareDimension, const MonitoringOptions& options) { // Function find aruco codes in video
 
-    Mat frame;                                                                                                      // Define a matrix as the current frame
+    /*
+        The work is split in four stages that each run on their own thread(s):
 
-    vector<int> markerIDs;                                                                                          // Make a vector of integers with the marker IDs
-    vector<vector<Point2f>> markerCorners, rejectedCandidates;                                                      // Make a vector of vectors with the markerCorners, and the rejected candidates
+            decode -> detection (x detectionWorkers) -> pose -> display
 
-    aruco::DetectorParameters parameters;                                                                           // Detect the parameters of the aruco codes
-    Ptr<aruco::Dictionary> markerDictionary = aruco::getPredefinedDictionary(aruco::PREDEFINED_DICTIONARY_NAME::DICT_4X4_50);   // Define the aruco dictionary as the standard 4x4 dictionary
+        Stages are connected by small lock-free rings. When a stage cannot keep
+        up, the oldest frame waiting for it is dropped, so decoding of the next
+        frame overlaps detection of the current one and we never queue up
+        stale frames.
+
+        Frames live in a pool of preallocated buffers (image, corners, IDs,
+        poses) sized for everything that can be in flight at once, and
+        every stage reuses the buffers of the frame it works on, so the
+        steady state does not go through the allocator.
 
-    VideoCapture vid("../videos/aruco-40.mov");                                                                     // Define video capturing element
+        In tracking mode detection keeps state from one frame to the next,
+        so it runs on a single worker that sees the frames in order.
 
-    if (!vid.isOpened()) {                                                                                          // If we cannot open the video, exit the program
+        The frames can come from a recorded session instead of a video, and
+        the run itself can be recorded (frames from the decode stage,
+        markers and poses from the pose stage) to be replayed later.
+
+        The display stage only draws when someone looks: headless, it just
+        hands the frames back to the pool. In preview mode, a few frames per
+        second go to a preview thread that draws onto a downscaled copy, so
+        the main thread only shows finished previews.
+
+        With a frame budget, the decode stage stamps every frame with the
+        current quality level (see FrameBudget.hpp) and the display stage
+        reports what the frame cost, so the next frames are detected on a
+        coarser level, only around the previous markers, without pose or
+        without drawing until there is headroom again.
+    */
+
+    signal(SIGINT, requestInterrupt);
+
+    unique_ptr<FrameSource> source = openFrameSource(options.videoPath, options.realtime, options.camera);          // Camera, video file or recorded session
+    bool live = source && source->isLive();
+
+    if (!source) {                                                                                                  // If we cannot open the video, exit the program
         return -1;
     }
 
-    cv::namedWindow("Video", WINDOW_AUTOSIZE);                                                                     // Create a named window
+    const SessionReader* replayedSession = nullptr;                                                                 // Detections recorded in the session we replay, to compare against
+    if (SessionSource* session = dynamic_cast<SessionSource*>(source.get())) {
+        replayedSession = &session->session();
+    }
+
+    SessionWriter recorder;
+    if (!options.recordPath.empty()) {
+        if (source->frameSize().area() == 0 || !recorder.open(options.recordPath, source->frameSize(), CV_8UC3, options.recordCompression)) {
+            cout << "Could not record to " << options.recordPath << endl;
+            return -1;
+        }
+    }
 
-    vector<Vec3d> rotationVectors, translationVectors;                                                              // Create a vector of 3d vectors containing the rotation and translation vectors
-    Mat rotationMatrix;
+    DetectionPublisher publisher;                                                                                   // Detections shared with other processes, if asked for
+    if (!options.publishName.empty() && !publisher.open(options.publishName)) {
+        cout << publisher.error() << endl;
+        return -1;
+    }
+
+    Ptr<aruco::Dictionary> markerDictionary = aruco::getPredefinedDictionary(aruco::PREDEFINED_DICTIONARY_NAME::DICT_4X4_50);   // Define the aruco dictionary as the standard 4x4 dictionary
 
-    int nFrame = 0;
+    int detectionWorkers = options.trackMarkers ? 1 : options.detectionWorkers;
 
-    while (true) {                                                                                                  // Loop
-        if (!vid.read(frame)) {                                                                                     // If we cannot read the frame, exit the loop
-            break;
+    size_t ringCapacity = RingBuffer<FramePacket>::roundedCapacity(stageQueueCapacity);
+    FramePool<FrameBuffers> framePool(3 * ringCapacity + detectionWorkers + 6);                                    // Every queue full, one frame in every thread, one being dropped and two in the preview
+    Size frameSize = source->frameSize();
+    framePool.forEachSlot([&](FrameBuffers& buffers) {                                                              // Allocate everything up front
+        if (frameSize.area() > 0) {
+            buffers.frame.create(frameSize, CV_8UC3);
         }
+        buffers.markerIDs.reserve(maxMarkersPerFrame);
+        buffers.markerCorners.reserve(maxMarkersPerFrame);
+        buffers.rotationVectors.reserve(maxMarkersPerFrame);
+        buffers.translationVectors.reserve(maxMarkersPerFrame);
+    });
+
+    RingBuffer<FramePacket> detectQueue(stageQueueCapacity), poseQueue(stageQueueCapacity), displayQueue(stageQueueCapacity);  // Queues between the stages (destroyed before the pool)
+    PipelineStats stats;
+    unique_ptr<FrameBudgetScheduler> scheduler;                                                                     // Only with a frame budget
+    if (options.budgetMilliseconds > 0.0) {
+        FrameBudgetSettings budget;
+        budget.budgetMilliseconds = options.budgetMilliseconds;
+        budget.roi = detectionWorkers == 1;                                                                         // Each worker only sees every N-th frame, none of them can track
+        scheduler.reset(new FrameBudgetScheduler(budget));
+    }
+    atomic<bool> stopRequested(false);                                                                              // Set when the user closes the video early
+
+    thread decodeThread([&]() {                                                                                     // Decode stage: read frames from the video
+        TRACE_THREAD("decode");
+        for (int nFrame = 0; !stopRequested.load() && !interruptRequested.load(); nFrame++) {
+            FramePacket packet;
+            while (!(packet.buffers = framePool.acquire()) && !stopRequested.load()) {                              // Every buffer is still in use downstream, wait for one
+                this_thread::yield();
+            }
+            if (!packet.buffers) {
+                break;
+            }
 
-        aruco::detectMarkers(frame, markerDictionary, markerCorners, markerIDs);                                    // Run the detect marker function (built into OpenCV Aruco)
-        
-        putText(frame, "Number of marker detected: " + to_string(markerIDs.size()), Point(20, 40), FONT_HERSHEY_SIMPLEX, 1, Scalar::all(255), 1, 8);    // Display how many aruco codes are found in the frame
+            ScopedAllocations allocations(stats.decodeAllocations, nFrame >= allocationWarmupFrames);
+            auto start = chrono::steady_clock::now();
 
-        if (markerIDs.size() > 0)
-        {
-            drawDetectedMarkerAxis(frame, markerCorners, markerIDs, cameraMatrix, true);
-        }
+            bool decoded;
+            {
+                TRACE_SCOPE("decode");
+                decoded = source->read(packet.buffers->frame, packet.timestampMilliseconds);                        // Decodes into the pooled image
+            }
+            if (!decoded) {                                                                                         // If we cannot read the frame, we are at the end of the video
+                break;
+            }
 
-        cv::imshow("Video", frame);
-        cv::waitKey(1);
+            packet.index = nFrame;
+            packet.quality = scheduler ? scheduler->level() : QUALITY_FULL;
+            packet.captureTime = chrono::steady_clock::now();
+            stats.decode.record(packet.captureTime - start);                                                        // For a live camera: waiting for the next frame
+            if (live) {
+                packet.captureTime = steadyTimePoint(packet.timestampMilliseconds);                                 // End to end then means glass to display
+            }
+
+            if (recorder.isOpen()) {                                                                                // Before anything is drawn on the frame
+                recorder.writeFrame(packet.index, packet.timestampMilliseconds, packet.buffers->frame);
+            }
+
+            detectQueue.pushDropOldest(move(packet));
+        }
+        detectQueue.close();
+    });
+
+    atomic<int> activeDetectors(detectionWorkers);
+    vector<thread> detectThreads;
+    for (int w = 0; w < detectionWorkers; w++) {                                                                    // Detection stage: several workers share the same input queue
+        detectThreads.emplace_back([&]() {
+            TRACE_THREAD("detection");
+            RoiMarkerDetector roiDetector(markerDictionary, options.detector);                                      // Tracking mode
+            PyramidMarkerDetector frameDetector(markerDictionary, options.detector);                                // Coarse-to-fine when the config has pyramid levels
+            DetectorConfig coarseConfig = options.detector;
+            coarseConfig.pyramidLevels = max(0, coarseConfig.pyramidLevels) + 1;
+            PyramidMarkerDetector coarseDetector(markerDictionary, coarseConfig);                                   // One level further down, for frames over budget
+            RoiMarkerDetector budgetRoiDetector(markerDictionary, coarseConfig);                                    // Its full searches are coarse too, the roi level never costs more than the coarse one
+            roiDetector.fullSearchInterval = options.fullSearchInterval;
+            budgetRoiDetector.fullSearchInterval = options.fullSearchInterval;
+            QualityLevel lastQuality = QUALITY_FULL;
+
+            FramePacket packet;
+            while (detectQueue.waitPop(packet)) {
+                {
+                    ScopedAllocations allocations(stats.detectionAllocations, packet.index >= allocationWarmupFrames);
+                    ScopedLatency timer(stats.detection, packet.work);
+                    FrameBuffers& buffers = *packet.buffers;
+                    if (options.trackMarkers) {
+                        roiDetector.detect(buffers.frame, buffers.markerCorners, buffers.markerIDs);                // Search near the previous detections
+                    } else if (packet.quality >= QUALITY_ROI && detectionWorkers == 1) {
+                        if (lastQuality < QUALITY_ROI) {                                                            // Its tracks stopped when the quality went back up, they are out of date
+                            budgetRoiDetector.reset();
+                        }
+                        budgetRoiDetector.detect(buffers.frame, buffers.markerCorners, buffers.markerIDs);
+                    } else if (packet.quality >= QUALITY_COARSE) {
+                        coarseDetector.detect(buffers.frame, buffers.markerCorners, buffers.markerIDs);
+                    } else {
+                        frameDetector.detect(buffers.frame, buffers.markerCorners, buffers.markerIDs);              // Run the detect marker function (built into OpenCV Aruco), on a pyramid level if configured
+                    }
+                    lastQuality = packet.quality;
+                }
+                if (live) {
+                    stats.glassToDetection.record(chrono::steady_clock::now() - packet.captureTime);
+                }
+                poseQueue.pushDropOldest(move(packet));
+            }
+            closeWhenLastWorker(activeDetectors, poseQueue);
+        });
     }
-    return 1;
 
-}
+    thread poseThread([&]() {                                                                                       // Pose stage: rotation and translation of every detected marker
+        TRACE_THREAD("pose");
+        MarkerPoseEstimator poseEstimator(intrinsics, distortionCoefficients, arucoSquareDimension);               // Keeps the undistortion lookup and corner buffers across frames
+        if (!cornerUndistorter.empty()) {
+            poseEstimator.useUndistorter(cornerUndistorter);
+        }
+        FramePacket packet;
+        SessionDetections recorded;
+        const vector<ConeBlob> noCones;                                                                             // aruco does not look for cones
+        ObjectTracker objectTracker;
+        vector<ObjectDetection> objectDetections;
+        objectDetections.reserve(maxMarkersPerFrame);
+        const vector<TrackedObject> noTracks;
+        while (poseQueue.waitPop(packet)) {
+            FrameBuffers& buffers = *packet.buffers;
+            {
+                ScopedAllocations allocations(stats.poseAllocations, packet.index >= allocationWarmupFrames);
+                buffers.rotationVectors.clear();                                                                   // The pooled buffers still hold the poses of an older frame
+                buffers.translationVectors.clear();
+                if (!buffers.markerIDs.empty() && packet.quality < QUALITY_NO_POSE) {                               // Over budget, the markers are published without their pose
+                    ScopedLatency timer(stats.pose, packet.work);
+                    poseEstimator.estimate(buffers.markerCorners, buffers.frame.size(), buffers.rotationVectors, buffers.translationVectors);
+                }
+            }
+
+            if (options.trackObjects && packet.quality < QUALITY_NO_POSE) {                                         // Same marker ID, same track, through occlusions and with less jitter. Without poses the tracks wait, they are predicted over the gap on the next posed frame
+                ScopedLatency timer(stats.tracking, packet.work);
+                objectDetections.clear();
+                for (size_t i = 0; i < buffers.translationVectors.size(); i++) {
+                    const Vec3d& t = buffers.translationVectors[i];
+                    objectDetections.push_back({buffers.markerIDs[i], Point3f((float)t[0], (float)t[1], (float)t[2])});
+                }
+                objectTracker.update(objectDetections, packet.timestampMilliseconds);
+                stats.tracksStarted = objectTracker.tracksStarted();
+            }
 
-bool loadCameraCalibration(string name, Mat& cameraMatrix, Mat& distortionCoefficients, bool showResults = false) {     // Function to load camera calibration matrix
+            if (options.poseStream != nullptr) {                                                                    // Stream the 3D position of every marker
+                writeMarkerPoses(*options.poseStream, packet.index, packet.timestampMilliseconds, buffers.markerIDs, buffers.rotationVectors, buffers.translationVectors);
+            }
+
+            if (recorder.isOpen()) {
+                recorder.writeMarkers(packet.index, packet.timestampMilliseconds, buffers.markerIDs, buffers.markerCorners, buffers.rotationVectors, buffers.translationVectors);
+            }
 
-    ifstream inStream(name);
+            if (publisher.isOpen()) {                                                                               // Downstream processes read it from shared memory
+                TRACE_SCOPE("publish");
+                publisher.publish(packet.index, packet.timestampMilliseconds, buffers.markerIDs, buffers.markerCorners, buffers.rotationVectors, buffers.translationVectors, noCones,
+                                  options.trackObjects ? objectTracker.tracks() : noTracks);
+            }
 
-    if (inStream){
-        uint16_t rows;
-        uint16_t columns;
+            if (replayedSession != nullptr && replayedSession->detections(packet.index, recorded)) {               // Regression check against the recorded run
+                stats.comparedFrames++;
+                if (!sameDetections(recorded, buffers.markerIDs, buffers.markerCorners)) {
+                    stats.differingFrames++;
+                }
+            }
 
-        // Camera Matrix
-        inStream >> rows;
-        inStream >> columns;
+            displayQueue.pushDropOldest(move(packet));
+        }
+        displayQueue.close();
+    });
 
-        cameraMatrix = Mat(Size(rows, columns), CV_64F);
+    if (options.display != DISPLAY_HEADLESS) {
+        cv::namedWindow("Video", WINDOW_AUTOSIZE);                                                                 // Create a named window (highgui has to stay on the main thread)
+    }
 
-        for (int r = 0; r < rows; r++){
-            for(int c = 0; c < columns; c++){
-                double read = 0.0f;
-                
-                inStream >> read;
-                cameraMatrix.at<double>(r, c) = read;
-                
-                if (showResults)
+    mutex previewMutex;                                                                                             // Hand-off between the display stage and the preview thread
+    condition_variable previewRequested;
+    FrameRef<FrameBuffers> previewFrame;                                                                            // Frame waiting for the preview thread, shared with the pool (no copy)
+    Mat previewImage;                                                                                               // Last preview drawn, waiting to be shown
+    bool previewDrawn = false, previewStopping = false;
+
+    thread previewThread;
+    if (options.display == DISPLAY_PREVIEW) {
+        previewThread = thread([&]() {                                                                              // Preview stage: downscale and draw, away from the pipeline
+            TRACE_THREAD("preview");
+            Mat preview;
+            vector<vector<Point2f>> scaledCorners;
+            while (true) {
+                FrameRef<FrameBuffers> frame;
                 {
-                    cout << cameraMatrix.at<double>(r, c) << endl;
+                    unique_lock<mutex> lock(previewMutex);
+                    previewRequested.wait(lock, [&]() { return (bool)previewFrame || previewStopping; });
+                    if (!previewFrame) {
+                        break;
+                    }
+                    frame = move(previewFrame);
                 }
+
+                {
+                    ScopedLatency timer(stats.preview);
+                    TRACE_SCOPE("preview");
+                    resize(frame->frame, preview, Size(), options.previewScale, options.previewScale, INTER_AREA);
+                    drawMarkerCount(preview, frame->markerIDs.size(), options.previewScale);
+                    if (!frame->markerIDs.empty()) {
+                        scaleMarkerCorners(frame->markerCorners, options.previewScale, scaledCorners);
+                        drawDetectedMarkerAxis(preview, scaledCorners, frame->markerIDs, true);
+                    }
+                }
+                frame.reset();                                                                                      // Back to the pool before the preview is handed over
+
+                lock_guard<mutex> lock(previewMutex);
+                swap(preview, previewImage);                                                                        // The preview buffers go round, they stop allocating once they have the preview size
+                previewDrawn = true;
             }
-        }
+        });
+    }
 
-        // Distance Coefficients
-        inStream >> rows;
-        inStream >> columns;
+    FramePacket packet;
+    int lastShownFrame = -1;
+    size_t droppedSeen = 0;                                                                                         // Frames dropped by the queues, already passed to the frame budget
+    Mat shownPreview;
+    chrono::steady_clock::time_point nextPreview = chrono::steady_clock::now();
+    chrono::steady_clock::duration previewPeriod = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1.0 / options.previewRate));
+    while (displayQueue.waitPop(packet)) {                                                                          // Display stage: runs on the main thread
+        bool outOfOrder = packet.index < lastShownFrame;                                                            // Detection workers can finish out of order, never go back in time
+        lastShownFrame = max(lastShownFrame, packet.index);
 
-        distortionCoefficients = Mat::zeros(rows, columns, CV_64F);
+        {
+            ScopedAllocations allocations(stats.displayAllocations, packet.index >= allocationWarmupFrames);
+            ScopedLatency timer(stats.display, packet.work);
+            TRACE_SCOPE("display");
+            FrameBuffers& buffers = *packet.buffers;
+
+            bool draw = packet.quality < QUALITY_NO_DRAWING && !outOfOrder;                                         // Over budget, the window keeps the last frame shown
 
-        for (int r = 0; r < rows; r++){
-            for(int c = 0; c < columns; c++){
-                double read = 0.0f;
+            if (options.display == DISPLAY_FULL) {
+                if (draw) {
+                    drawMarkerCount(buffers.frame, buffers.markerIDs.size());                                      // Display how many aruco codes are found in the frame
 
-                inStream >> read;
+                    if (buffers.markerIDs.size() > 0)
+                    {
+                        drawDetectedMarkerAxis(buffers.frame, buffers.markerCorners, buffers.markerIDs, true);
+                    }
 
-                distortionCoefficients.at<double>(r, c) = read;
-                
-                if (showResults)
+                    cv::imshow("Video", buffers.frame);
+                }
+                if (cv::waitKey(1) == 27) {                                                                         // Even when nothing is drawn: the window keeps answering, and Escape stops the pipeline
+                    stopRequested.store(true);
+                }
+            } else if (options.display == DISPLAY_PREVIEW) {
+                bool showPreview = false, pollWindow = false;
                 {
-                    cout << distortionCoefficients.at<double>(r, c) << endl;
+                    lock_guard<mutex> lock(previewMutex);
+                    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+                    if (now >= nextPreview && !previewFrame) {                                                      // When the preview thread is behind, the next frame gets another chance
+                        if (draw) {
+                            previewFrame = packet.buffers;
+                            previewRequested.notify_one();
+                        } else {
+                            pollWindow = true;                                                                      // Nothing to preview, the window events are still handled at the preview rate
+                        }
+                        nextPreview = now + previewPeriod;
+                    }
+                    if (previewDrawn) {
+                        swap(previewImage, shownPreview);
+                        previewDrawn = false;
+                        showPreview = true;
+                    }
+                }
+
+                if (showPreview) {
+                    cv::imshow("Video", shownPreview);
+                }
+                if (showPreview || pollWindow) {
+                    if (cv::waitKey(1) == 27) {
+                        stopRequested.store(true);
+                    }
                 }
             }
         }
-        inStream.close();
-        return true;
+        stats.endToEnd.record(chrono::steady_clock::now() - packet.captureTime);                                   // Frames not shown count too, the budget must see every frame's work
+        if (scheduler) {
+            scheduler->frameDone(packet.quality, packet.work);
+            size_t dropped = detectQueue.dropped() + poseQueue.dropped() + displayQueue.dropped();                  // Frames that never got here are over budget too
+            scheduler->framesDropped(dropped - droppedSeen);
+            droppedSeen = dropped;
+        }
+    }
 
+    decodeThread.join();
+    for (thread& t : detectThreads) {
+        t.join();
+    }
+    poseThread.join();
+    if (previewThread.joinable()) {
+        {
+            lock_guard<mutex> lock(previewMutex);
+            previewStopping = true;
+        }
+        previewRequested.notify_one();
+        previewThread.join();
     }
 
-    return false;
-}
+    packet.buffers.reset();                                                                                         // Back to the pool before the counts are printed
+    printPipelineStats(stats, detectQueue, poseQueue, displayQueue, framePool, scheduler.get());
 
+    return 1;
+
+}
 
 int main(int argv, char** argc) {
 
+    const String keys =
+        "{help h             |                          | print this message }"
+        "{video              | ../videos/aruco-40.mov   | camera index, video or recorded session to look for aruco codes in }"
+        "{realtime           |                          | replay a recorded session at its recorded pace }"
+        "{stand-in           |                          | play the video as if it were a live camera }"
+        "{fourcc             | MJPG                     | live camera pixel format (MJPG or YUYV) }"
+        "{width              | 0                        | live camera width (0 = driver default) }"
+        "{height             | 0                        | live camera height (0 = driver default) }"
+        "{fps                | 0                        | live camera frame rate (0 = driver default) }"
+        "{exposure           | -1                       | lock the live camera exposure to this value (-1 = automatic) }"
+        "{record             |                          | record the frames, detections and poses of this run to a session file }"
+        "{record-png         |                          | store the recorded frames as PNG instead of raw pixels }"
+        "{display            | full                     | full, preview (downscaled, drawn on its own thread) or headless }"
+        "{preview-scale      | 0.5                      | size of the preview relative to the frame }"
+        "{preview-rate       | 10                       | previews per second }"
+        "{publish            |                          | publish the detections to this shared memory stream (e.g. /3dvis-detections) }"
+        "{calibration        | ../cameraCalibration.bin | binary camera calibration written by calibrate }"
+        "{legacy-calibration | ../cameraCalibration     | text calibration used when there is no binary one }"
+        "{detectors          | 0                        | number of detection threads (0 = one per spare core) }"
+        "{detector           | ../detector.yml          | marker detector settings }"
+        "{pyramid            | -1                       | detect on this pyramid level, refine at full resolution (-1 = from the detector settings) }"
+        "{poses              |                          | stream marker poses as CSV to this file (- for stdout) }"
+        "{track              |                          | only search for markers around their previous positions }"
+        "{full-search        | 15                       | frames between two full-frame searches when tracking }"
+        "{object-tracks      |                          | follow the marker positions across frames with Kalman filtered tracks (published with --publish) }"
+        "{budget             | 0                        | work allowed per frame [ms], lower the quality of frames over it (0 = always full quality) }";
+
+    CommandLineParser parser(argv, argc, keys);
+    if (parser.has("help")) {
+        parser.printMessage();
+        return 0;
+    }
+
+    TRACE_START("aruco");                                               // Only with the THREEDVIS_TRACE build option
+
+    int detectionWorkers = parser.get<int>("detectors");
+    if (detectionWorkers <= 0) {                                        // Decode, pose and display each keep a thread busy, detection gets the rest
+        detectionWorkers = max(1, (int)thread::hardware_concurrency() - 3);
+    }
+
     Mat cameraMatrix = Mat::eye(3, 3, CV_64F);                          // Define camera calibration matrix
 
     Mat distortionCoefficients;                                         // Define distance coefficients matrix
 
+    MappedCalibration calibrationFile;                                  // Binary calibration, mapped for the whole run (the maps point into it)
+    CornerUndistorter cornerUndistorter;                                // Stays empty (built on the first frame) without a binary calibration
+
     cout << "Loading camera calibration matrix..." << endl;
-    loadCameraCalibration("../cameraCalibration", cameraMatrix, distortionCoefficients);
+    if (calibrationFile.open(parser.get<String>("calibration"))) {
+        cameraMatrix = calibrationFile.calibration().cameraMatrix;
+        distortionCoefficients = calibrationFile.calibration().distortionCoefficients;
 
-    cout << "Camera parameters loaded! Starting monitoring for aruco codes..." << endl << endl;
+        const CameraCalibration& stored = calibrationFile.calibration();
+        if (!stored.cornerLookup.empty()) {                             // Use the undistortion lookup computed by calibrate
+            cornerUndistorter.adopt(stored.cornerLookup, stored.imageSize, stored.cornerGridStep);
+        }
+    } else {
+        cout << "   " << calibrationFile.error() << ", falling back to " << parser.get<String>("legacy-calibration") << endl;
+        if (!loadLegacyCalibration(parser.get<String>("legacy-calibration"), cameraMatrix, distortionCoefficients)) {
+            cout << "No camera calibration found, exiting program..." << endl;
+            return -1;
+        }
+    }
+
+    CameraIntrinsics intrinsics(cameraMatrix);                          // Inverse and batch projection coefficients are computed once here
+
+    cout << "Camera parameters loaded! Starting monitoring for aruco codes with " << detectionWorkers << " detection thread(s)..." << endl << endl;
+
+    MonitoringOptions options;
+    options.videoPath = parser.get<String>("video");
+    options.realtime = parser.has("realtime");
+    options.camera.standIn = parser.has("stand-in");
+    options.camera.fourcc = parser.get<String>("fourcc");
+    options.camera.resolution = Size(parser.get<int>("width"), parser.get<int>("height"));
+    options.camera.fps = parser.get<double>("fps");
+    options.camera.exposure = parser.get<double>("exposure");
+    options.recordPath = parser.get<String>("record");
+    options.recordCompression = parser.has("record-png") ? SESSION_PNG : SESSION_RAW;
+    options.publishName = parser.get<String>("publish");
+    options.previewScale = parser.get<double>("preview-scale");
+    options.previewRate = parser.get<double>("preview-rate");
+
+    String display = parser.get<String>("display");
+    if (display == "preview") {
+        options.display = DISPLAY_PREVIEW;
+    } else if (display == "headless") {
+        options.display = DISPLAY_HEADLESS;
+    } else if (display != "full") {
+        cout << "Unknown display " << display << ", use full, preview or headless" << endl;
+        return -1;
+    }
+    if (options.previewScale <= 0 || options.previewRate <= 0) {
+        cout << "The preview scale and rate must be positive" << endl;
+        return -1;
+    }
+    options.detectionWorkers = detectionWorkers;
+    options.trackMarkers = parser.has("track");
+    options.fullSearchInterval = parser.get<int>("full-search");
+    options.trackObjects = parser.has("object-tracks");
+    options.budgetMilliseconds = parser.get<double>("budget");
+
+    if (!loadDetectorConfig(parser.get<String>("detector"), options.detector)) {   // The OpenCV defaults are fine without a file
+        cout << "No detector settings in " << parser.get<String>("detector") << ", using the defaults" << endl;
+    }
+    if (parser.get<int>("pyramid") >= 0) {
+        options.detector.pyramidLevels = parser.get<int>("pyramid");
+    }
+
+    String posesPath = parser.get<String>("poses");
+    ofstream poseFile;
+    if (posesPath == "-") {
+        options.poseStream = &cout;
+    } else if (!posesPath.empty()) {
+        poseFile.open(posesPath);
+        options.poseStream = &poseFile;
+    }
+    if (options.poseStream != nullptr) {
+        *options.poseStream << "frame,timestampMs,id,tx,ty,tz,rx,ry,rz" << endl;
+    }
 
-    startCameraMonitoring(cameraMatrix, distortionCoefficients, arucoSquareDimension);
+    startCameraMonitoring(intrinsics, distortionCoefficients, cornerUndistorter, arucoSquareDimension, options);
 
     return 0;
 }
@@ -1,6 +1,8 @@
 #include <opencv2/opencv.hpp>
 #include <stdint.h>
 
+#include "../core/ChannelKernels.hpp"
+
 using namespace std;
 using namespace cv;
 
@@ -25,6 +27,10 @@ int main(int argv, char** argc) {
     merge(splitChannels, 3, output);    // Merge the 3 channels we have (including the modified channel)
     imshow("Merged", output);           // Show the merged channel in a window
 
+    Mat inPlace = original.clone();     // Same result without splitting: the channel is zeroed in place, no extra planes
+    maskChannel(inPlace, channel);
+    imshow("Masked in place", inPlace);
+
     waitKey(0);
 
     return 0;
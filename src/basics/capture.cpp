@@ -1,29 +1,67 @@
 #include <opencv2/opencv.hpp>
 #include <stdint.h>
 
+#include <iostream>
+
+#include "../core/FrameSource.hpp"
+#include "../core/LatencyStats.hpp"
+#include "../core/Trace.hpp"
+
 using namespace cv;
 using namespace std;
 
-const int fps = 60;
-
 int main(int argv, char** argc) {
 
-    Mat frame;                                      // Store the current frame
+    const String keys =
+        "{help h   |                       | print this message }"
+        "{device   | 0                     | camera index, or a video file played as a stand-in for a camera }"
+        "{fourcc   | MJPG                  | pixel format (MJPG or YUYV) }"
+        "{width    | 0                     | frame width (0 = driver default) }"
+        "{height   | 0                     | frame height (0 = driver default) }"
+        "{fps      | 0                     | frame rate (0 = driver default) }"
+        "{exposure | -1                    | lock the exposure to this value (-1 = automatic) }";
+
+    CommandLineParser parser(argv, argc, keys);
+    if (parser.has("help")) {
+        parser.printMessage();
+        return 0;
+    }
+
+    TRACE_START("capture");
+
+    LiveCameraSettings settings;                    // How the camera is configured (buffer size is always 1)
+    settings.fourcc = parser.get<String>("fourcc");
+    settings.resolution = Size(parser.get<int>("width"), parser.get<int>("height"));
+    settings.fps = parser.get<double>("fps");
+    settings.exposure = parser.get<double>("exposure");
 
-    VideoCapture vid("../videos/test-40.mov");      // VideoCapture object - vid can load in stream data, webcam, or a video file
+    LiveCameraSource camera(parser.get<String>("device"), settings);   // Grabs on its own thread and only keeps the newest frame
 
-    // if (!vid.isOpened()) {                       // If no video is detected, exit the program (for live feeds only)
-    //     return -1;
-    // }
+    if (!camera.isOpened()) {                       // If no camera is detected, exit the program
+        cout << "Could not open " << parser.get<String>("device") << endl;
+        return -1;
+    }
+
+    Mat frame;                                      // Store the current frame
+    double timestamp;                               // When the sensor delivered it (steady clock) [ms]
+    LatencyHistogram glassToDisplay;
+
+    while (camera.read(frame, timestamp)) {         // Blocks until a new frame is there, no artificial pacing
+        TRACE_SCOPE("display");
 
-    while (vid.read(frame)) {
-        
         imshow("Video Feed", frame);
 
-        if(waitKey( 1000/fps ) >= 0) {
+        glassToDisplay.record(chrono::steady_clock::now() - steadyTimePoint(timestamp));
+
+        if (waitKey(1) >= 0) {
             break;
         }
     }
-    
+
+    camera.stop();
+
+    cout << "Glass to display: " << glassToDisplay.count() << " frames, p50 " << glassToDisplay.percentileMilliseconds(0.5) << " ms, p99 " << glassToDisplay.percentileMilliseconds(0.99) << " ms, max " << glassToDisplay.maxMilliseconds() << " ms" << endl;
+    cout << "Frames skipped because a newer one arrived: " << camera.skipped() << endl;
+
     return 1;
 }
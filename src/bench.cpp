@@ -0,0 +1,358 @@
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+#include <opencv2/aruco.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <memory>
+
+#include "core/LatencyStats.hpp"
+#include "core/MarkerDrawing.hpp"
+#include "core/Fourier.hpp"
+#include "core/Chessboard.hpp"
+#include "core/ConeRange.hpp"
+#include "core/ConeSegmentation.hpp"
+#include "core/FrameSource.hpp"
+#include "core/MarkerDetection.hpp"
+#include "core/ChannelKernels.hpp"
+
+using namespace std;
+using namespace cv;
+
+/*
+    Headless benchmark: replays the test videos, the DFT test image and the
+    calibration images through the same functions the tools use, without any
+    window, and reports per-stage latency percentiles as JSON so runs can be
+    compared against the 60 Hz frame budget.
+*/
+
+const double frameBudgetMilliseconds = 1000.0 / 60.0;   // Frame time of a 60 Hz camera
+
+struct BenchStages {                                    // One histogram per measured stage
+    LatencyHistogram decode, detectMarkers, detectMarkersPyramid, drawMarkers, coneSegmentation, coneRanging, dftForward, dftInverse, frequencyFilter, chessboardCorners;
+    LatencyHistogram channelMaskAt, channelMaskSplitMerge, channelMaskKernel, channelExtractSplit, channelExtractKernel, channelMixAt, channelMixKernel;
+};
+
+struct VideoResult {                                    // Throughput of one replayed video
+    string path;
+    int frames = 0;
+    double seconds = 0.0;
+};
+
+vector<cv::String> findFiles(const string& pattern) {                              // Files matching a pattern, empty if the directory does not exist
+
+    vector<cv::String> fn;
+    try {
+        glob(pattern, fn, false);
+    } catch (const cv::Exception&) {                    // glob throws when it cannot open the directory
+        cerr << "Nothing found for " << pattern << endl;
+    }
+    return fn;
+}
+
+VideoResult benchVideo(const string& path, int maxFrames, BenchStages& stages) {    // Decode, detect, segment and draw every frame of a video
+
+    VideoResult result;
+    result.path = path;
+
+    unique_ptr<FrameSource> source = openFrameSource(path);           // Recorded sessions are replayed without any video decode
+    if (!source) {
+        cerr << "Skipping " << path << endl;
+        return result;
+    }
+
+    Ptr<aruco::DetectorParameters> parameters = aruco::DetectorParameters::create();
+    Ptr<aruco::Dictionary> markerDictionary = aruco::getPredefinedDictionary(aruco::PREDEFINED_DICTIONARY_NAME::DICT_4X4_50);
+
+    DetectorConfig pyramidConfig;                       // Same detection on the half resolution level, corners refined at full resolution
+    pyramidConfig.pyramidLevels = 1;
+    PyramidMarkerDetector pyramidDetector(markerDictionary, pyramidConfig);
+
+    ConeSegmenter coneSegmenter;
+    CameraIntrinsics nominalIntrinsics(Mat(Matx33d(1000, 0, 640, 0, 1000, 360, 0, 0, 1)));     // No calibration here, the cost does not depend on the values
+    ConeRangeEstimator coneRanger(nominalIntrinsics, Mat(), GroundPlane(1.0, 0.1));
+
+    Mat frame;
+    double timestamp;
+    vector<int> markerIDs;
+    vector<vector<Point2f>> markerCorners;
+    vector<int> pyramidIDs;
+    vector<vector<Point2f>> pyramidCorners;
+    vector<ConeBlob> coneBlobs;
+    vector<ConeRange> coneRanges;
+
+    auto videoStart = chrono::steady_clock::now();
+
+    while (maxFrames <= 0 || result.frames < maxFrames) {
+        {
+            ScopedLatency timer(stages.decode);
+            if (!source->read(frame, timestamp)) {
+                break;
+            }
+        }
+
+        {
+            ScopedLatency timer(stages.detectMarkers);
+            aruco::detectMarkers(frame, markerDictionary, markerCorners, markerIDs, parameters);
+        }
+
+        {
+            ScopedLatency timer(stages.detectMarkersPyramid);
+            pyramidDetector.detect(frame, pyramidCorners, pyramidIDs);
+        }
+
+        {
+            ScopedLatency timer(stages.coneSegmentation);
+            coneSegmenter.segment(frame, coneBlobs);
+        }
+
+        {
+            ScopedLatency timer(stages.coneRanging);
+            coneRanger.estimate(coneBlobs, frame.size(), coneRanges);
+        }
+
+        {
+            ScopedLatency timer(stages.drawMarkers);
+            putText(frame, "Number of marker detected: " + to_string(markerIDs.size()), Point(20, 40), FONT_HERSHEY_SIMPLEX, 1, Scalar::all(255), 1, 8);
+            if (!markerIDs.empty()) {
+                drawDetectedMarkerAxis(frame, markerCorners, markerIDs, true);
+            }
+        }
+
+        result.frames++;
+    }
+
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - videoStart).count();
+    return result;
+}
+
+void benchDFT(const string& path, int repetitions, BenchStages& stages) {           // Forward and inverse DFT of the test image, then a low-pass filter
+
+    Mat original = imread(path, IMREAD_GRAYSCALE);
+    if (original.empty()) {
+        cerr << "Could not read " << path << ", skipping the DFT benchmark" << endl;
+        return;
+    }
+
+    DftPlan plan;
+    Mat invertedDFT;
+    for (int i = 0; i < repetitions; i++) {
+        {
+            ScopedLatency timer(stages.dftForward);
+            plan.forward(original, 1.0/255.0);
+        }
+        {
+            ScopedLatency timer(stages.dftInverse);
+            plan.inverse(invertedDFT);
+        }
+    }
+
+    FrequencyFilter filter;
+    filter.setLowPass(0.2);
+    Mat filtered;
+    for (int i = 0; i < repetitions; i++) {
+        ScopedLatency timer(stages.frequencyFilter);
+        filter.apply(original, filtered);
+    }
+}
+
+void benchChannelKernels(const string& path, int repetitions, BenchStages& stages) {   // SIMD channel kernels against the split/merge and at<> versions they replace
+
+    Mat original = imread(path, IMREAD_COLOR);
+    if (original.empty()) {
+        cerr << "Could not read " << path << ", skipping the channel kernel benchmark" << endl;
+        return;
+    }
+
+    const int channel = 2;
+    const Vec3f weights = coneLikelihoodWeights(30.0f);                 // Orange
+    Mat image, extracted, mixed;
+    Mat planes[3];
+
+    for (int i = 0; i < repetitions; i++) {
+        original.copyTo(image);                                         // Copies are not part of the measurements
+        {
+            ScopedLatency timer(stages.channelMaskAt);
+            for (int r = 0; r < image.rows; r++) {
+                for (int c = 0; c < image.cols; c++) {
+                    image.at<Vec3b>(r, c)[channel] = 0;
+                }
+            }
+        }
+
+        original.copyTo(image);
+        {
+            ScopedLatency timer(stages.channelMaskSplitMerge);
+            split(image, planes);
+            planes[channel] = Mat::zeros(planes[channel].size(), CV_8UC1);
+            merge(planes, 3, image);
+        }
+
+        original.copyTo(image);
+        {
+            ScopedLatency timer(stages.channelMaskKernel);
+            maskChannel(image, channel);
+        }
+
+        {
+            ScopedLatency timer(stages.channelExtractSplit);
+            split(original, planes);
+            extracted = planes[channel];
+        }
+        {
+            ScopedLatency timer(stages.channelExtractKernel);
+            extractChannel(original, extracted, channel);
+        }
+
+        mixed.create(original.size(), CV_8UC1);
+        {
+            ScopedLatency timer(stages.channelMixAt);
+            for (int r = 0; r < original.rows; r++) {
+                for (int c = 0; c < original.cols; c++) {
+                    const Vec3b& pixel = original.at<Vec3b>(r, c);
+                    mixed.at<uchar>(r, c) = saturate_cast<uchar>(weights[0] * pixel[0] + weights[1] * pixel[1] + weights[2] * pixel[2]);
+                }
+            }
+        }
+        {
+            ScopedLatency timer(stages.channelMixKernel);
+            weightedChannelMix(original, mixed, weights);
+        }
+    }
+}
+
+int benchChessboard(const string& pattern, BenchStages& stages) {                   // Corner search on every calibration image, returns how many were found
+
+    vector<cv::String> fn = findFiles(pattern);
+
+    int found = 0;
+    vector<Point2f> corners;
+    for (const cv::String& path : fn) {
+        Mat image = imread(path, IMREAD_COLOR);         // Loading is not part of the measurement
+        if (image.empty()) {
+            continue;
+        }
+
+        ScopedLatency timer(stages.chessboardCorners);
+        if (findCalibrationCorners(image, chessboardDimensions, corners)) {
+            found++;
+        }
+    }
+    return found;
+}
+
+void writeStage(ostream& out, const char* name, const LatencyHistogram& latency, bool last = false) {
+
+    double totalSeconds = latency.totalSeconds();
+
+    out << "    \"" << name << "\": {"
+        << "\"samples\": " << latency.count()
+        << ", \"meanMs\": " << latency.meanMilliseconds()
+        << ", \"p50Ms\": " << latency.percentileMilliseconds(0.5)
+        << ", \"p99Ms\": " << latency.percentileMilliseconds(0.99)
+        << ", \"maxMs\": " << latency.maxMilliseconds()
+        << ", \"callsPerSecond\": " << (totalSeconds > 0.0 ? latency.count() / totalSeconds : 0.0)
+        << "}" << (last ? "" : ",") << endl;
+}
+
+void writeReport(ostream& out, const vector<VideoResult>& videos, int chessboardsFound, const BenchStages& stages) {
+
+    int totalFrames = 0;
+    double totalSeconds = 0.0;
+
+    out << "{" << endl;
+    out << "  \"frameBudgetMs\": " << frameBudgetMilliseconds << "," << endl;
+
+    out << "  \"videos\": [" << endl;
+    for (size_t i = 0; i < videos.size(); i++) {
+        const VideoResult& video = videos[i];
+        totalFrames += video.frames;
+        totalSeconds += video.seconds;
+
+        out << "    {\"path\": \"" << video.path << "\", \"frames\": " << video.frames
+            << ", \"seconds\": " << video.seconds
+            << ", \"framesPerSecond\": " << (video.seconds > 0.0 ? video.frames / video.seconds : 0.0)
+            << "}" << (i + 1 < videos.size() ? "," : "") << endl;
+    }
+    out << "  ]," << endl;
+
+    out << "  \"framesPerSecond\": " << (totalSeconds > 0.0 ? totalFrames / totalSeconds : 0.0) << "," << endl;
+    out << "  \"chessboardsFound\": " << chessboardsFound << "," << endl;
+
+    out << "  \"stages\": {" << endl;
+    writeStage(out, "decode", stages.decode);
+    writeStage(out, "detectMarkers", stages.detectMarkers);
+    writeStage(out, "detectMarkersPyramid", stages.detectMarkersPyramid);
+    writeStage(out, "drawMarkers", stages.drawMarkers);
+    writeStage(out, "coneSegmentation", stages.coneSegmentation);
+    writeStage(out, "coneRanging", stages.coneRanging);
+    writeStage(out, "dftForward", stages.dftForward);
+    writeStage(out, "dftInverse", stages.dftInverse);
+    writeStage(out, "frequencyFilter", stages.frequencyFilter);
+    writeStage(out, "channelMaskAt", stages.channelMaskAt);
+    writeStage(out, "channelMaskSplitMerge", stages.channelMaskSplitMerge);
+    writeStage(out, "channelMaskKernel", stages.channelMaskKernel);
+    writeStage(out, "channelExtractSplit", stages.channelExtractSplit);
+    writeStage(out, "channelExtractKernel", stages.channelExtractKernel);
+    writeStage(out, "channelMixAt", stages.channelMixAt);
+    writeStage(out, "channelMixKernel", stages.channelMixKernel);
+    writeStage(out, "chessboardCorners", stages.chessboardCorners, true);
+    out << "  }" << endl;
+    out << "}" << endl;
+}
+
+int main(int argv, char** argc) {
+
+    const String keys =
+        "{help h      |                                   | print this message }"
+        "{videos      | ../videos/*.mov                   | videos or recorded sessions to replay through decode, detection and drawing }"
+        "{image       | ../images/bug.jpg                 | image used for the DFT and channel kernel benchmarks }"
+        "{calibration | ../calibration_images/calib_*.jpeg | calibration images used for the corner search benchmark }"
+        "{frames      | 0                                 | maximum number of frames per video (0 = all) }"
+        "{repeat      | 100                               | number of DFT and channel kernel repetitions }"
+        "{output o    |                                   | write the JSON report to this file instead of stdout }";
+
+    CommandLineParser parser(argv, argc, keys);
+    if (parser.has("help")) {
+        parser.printMessage();
+        return 0;
+    }
+
+    BenchStages stages;
+
+    vector<cv::String> videoPaths = findFiles(parser.get<String>("videos"));
+
+    vector<VideoResult> videos;
+    for (const cv::String& path : videoPaths) {
+        cerr << "Replaying " << path << "..." << endl;
+        videos.push_back(benchVideo(path, parser.get<int>("frames"), stages));
+    }
+
+    cerr << "Timing DFT..." << endl;
+    benchDFT(parser.get<String>("image"), parser.get<int>("repeat"), stages);
+
+    cerr << "Timing channel kernels..." << endl;
+    benchChannelKernels(parser.get<String>("image"), parser.get<int>("repeat"), stages);
+
+    cerr << "Timing chessboard corner search..." << endl;
+    int chessboardsFound = benchChessboard(parser.get<String>("calibration"), stages);
+
+    String outputPath = parser.get<String>("output");
+    if (outputPath.empty()) {
+        writeReport(cout, videos, chessboardsFound, stages);
+    } else {
+        ofstream outStream(outputPath);
+        if (!outStream) {
+            cerr << "Could not write " << outputPath << endl;
+            return -1;
+        }
+        writeReport(outStream, videos, chessboardsFound, stages);
+    }
+
+    return 0;
+}
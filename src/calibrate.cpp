@@ -4,54 +4,59 @@
 #include <opencv2/highgui.hpp>
 #include <opencv2/calib3d.hpp>
 
+#include <atomic>
 #include <sstream>
 #include <iostream>
 #include <fstream>
 
+#include "core/CalibrationFile.hpp"
+#include "core/CalibrationReport.hpp"
+#include "core/Chessboard.hpp"
+#include "core/CornerCache.hpp"
+#include "core/Parallel.hpp"
+#include "core/Trace.hpp"
+
 using namespace std;
 using namespace cv;
 
-const float calibrationSquareDimension = 0.03f;     // Dimension of side of one square [m]
-const Size chessboardDimensions = Size(4, 8);       // Number of square on Chessboard calibration page
-
-void createKnownBoardPosition(Size boardSize, float squareEdgeLength, vector<Point3f>& corners)
+size_t findAllChessboardCorners(const vector<cv::String>& imagePaths, CornerCache& cache, vector<ChessboardView>& views)  // Corner search over every image, in parallel, skipping the images already in the cache. Returns how many were in the cache
 {
-    for (int i = 0; i < boardSize.height; i++)
-    {
-        for (int j = 0; j < boardSize.width; j++)
+    TRACE_SCOPE("findAllChessboardCorners");
+
+    views.assign(imagePaths.size(), ChessboardView());                                                          // One slot per image so the workers never share anything
+    atomic<size_t> cacheHits(0);
+
+    parallelForRanges(Range(0, (int)imagePaths.size()), [&](const Range& range) {
+        size_t rangeHits = 0;
+        for (int i = range.start; i < range.end; i++)
         {
-            corners.push_back(Point3f(j * squareEdgeLength, i * squareEdgeLength, 0.0f));
-        }
-    }
-}
+            ChessboardView& view = views[i];
+            view.path = imagePaths[i];
+            view.fileHash = hashFile(view.path);                                                                // The contents decide if we already know this image
 
-void getChessboardCorners(vector<Mat> images, vector<vector<Point2f>>& allFoundCorners, bool showResults = false)   // Function to find chessboard corners from a set of images
-{
-    for (vector<Mat>::iterator iter = images.begin(); iter != images.end(); iter++)                                 // Loop through the saved images
-    {
-        vector<Point2f> pointBuf;                                                                                   // Define a vector of 2D points for the points detected called pointBuf
+            if (cache.lookup(view.fileHash, view))                                                              // Already searched in a previous run
+            {
+                rangeHits++;
+                continue;
+            }
 
-        bool found = findChessboardCorners(*iter, chessboardDimensions, pointBuf, CALIB_CB_NORMALIZE_IMAGE);        // Execute findChessboardCorners (built into OpenCV) to find the corners of the image
+            Mat frame = imread(view.path, IMREAD_GRAYSCALE);                                                    // Read image directly in grey, that is all the corner search needs
+            if (frame.empty())
+            {
+                continue;
+            }
 
-        if (found)                                                                                                  // If we have found the corners
-        {
-            allFoundCorners.push_back(pointBuf);                                                                    // Put the found points into pointBuf
+            view.imageSize = frame.size();
+            view.found = findCalibrationCorners(frame, chessboardDimensions, view.corners);                     // Find and refine the corners once
         }
+        cacheHits += rangeHits;
+    });
 
-        if (showResults)                                                                                            // If we have asked to show the results
-        {
-            drawChessboardCorners(*iter, chessboardDimensions, pointBuf, found);                                    // Draw the chessboard
-            imshow("Looking for corners", *iter);
-            waitKey(0);
-        }
-    }
+    return cacheHits.load();
 }
 
-void cameraCalibration(vector<Mat> calibrationImages, Size boardSize, float squareEdgeLength, Mat& cameraMatrix, Mat& distortionCoefficients)     // Function to calibrate cameras
+double cameraCalibration(const vector<vector<Point2f>>& chessboardImageSpacePoints, Size imageSize, Size boardSize, float squareEdgeLength, Mat& cameraMatrix, Mat& distortionCoefficients)   // Function to calibrate cameras, returns the RMS reprojection error
 {
-    vector<vector<Point2f>> chessboardImageSpacePoints;                                                                                         // Define identified points from chessboard into a vector of vectors
-    getChessboardCorners(calibrationImages, chessboardImageSpacePoints, false);                                                                 // Get points from chessboard using getChessboardCorners
-
     vector<vector<Point3f>> worldSpaceCornerPoints(1);
 
     createKnownBoardPosition(boardSize, squareEdgeLength, worldSpaceCornerPoints[0]);
@@ -60,103 +65,203 @@ void cameraCalibration(vector<Mat> calibrationImages, Size boardSize, float squa
     vector<Mat> rVectors, tVectors;
     distortionCoefficients = Mat::zeros(8, 1, CV_64F);
 
-    calibrateCamera(worldSpaceCornerPoints, chessboardImageSpacePoints, boardSize, cameraMatrix, distortionCoefficients, rVectors, tVectors);     // Function to calibrate camera from the previously cmoputed data
+    return calibrateCamera(worldSpaceCornerPoints, chessboardImageSpacePoints, imageSize, cameraMatrix, distortionCoefficients, rVectors, tVectors);  // Function to calibrate camera from the previously cmoputed data
 
 }
 
-bool saveCameraCalibration(string name, Mat cameraMatrix, Mat distortionCoefficients) {
-    ofstream outStream(name);
-    if (outStream)
-    {
-        uint16_t rows = cameraMatrix.rows;
-        uint16_t columns = cameraMatrix.cols;
-
-        outStream << rows << endl;
-        outStream << columns << endl;
+bool stereoCameraCalibration(const vector<ChessboardView>& leftViews, const vector<ChessboardView>& rightViews, Size boardSize, float squareEdgeLength, CameraCalibration& calibration)  // Function to calibrate a pair of cameras, image i of the left camera was taken together with image i of the right one
+{
+    vector<vector<Point2f>> leftCorners, rightCorners;                      // Every view where one camera sees the board, for its own intrinsics
+    vector<vector<Point2f>> leftPairCorners, rightPairCorners;              // Views where both cameras see the board, for the extrinsics
 
-        for (int r = 0; r < rows; r++)
+    for (size_t i = 0; i < leftViews.size() && i < rightViews.size(); i++)
+    {
+        if (leftViews[i].found)
         {
-            for (int c = 0; c < columns; c++)
-            {
-                double value = cameraMatrix.at<double>(r, c);
-                outStream << value << endl;
-            }
+            leftCorners.push_back(leftViews[i].corners);
+            calibration.imageSize = leftViews[i].imageSize;
         }
-
-        rows = distortionCoefficients.rows;
-        columns = distortionCoefficients.cols;
-
-        outStream << rows << endl;
-        outStream << columns << endl;
-
-        for (int r = 0; r < rows; r++)
+        if (rightViews[i].found)
         {
-            for (int c = 0; c < columns; c++)
-            {
-                double value = distortionCoefficients.at<double>(r, c);
-                outStream << value << endl;
-            }
+            rightCorners.push_back(rightViews[i].corners);
+        }
+        if (leftViews[i].found && rightViews[i].found)
+        {
+            leftPairCorners.push_back(leftViews[i].corners);
+            rightPairCorners.push_back(rightViews[i].corners);
         }
+    }
 
-        outStream.close();
-        return true;
+    if (leftPairCorners.empty())
+    {
+        return false;
     }
 
-    return false;
+    StereoCalibration& stereo = calibration.stereo;
+    calibration.cameraMatrix = Mat::eye(3, 3, CV_64F);
+    stereo.rightCameraMatrix = Mat::eye(3, 3, CV_64F);
+
+    calibration.reprojectionError = cameraCalibration(leftCorners, calibration.imageSize, boardSize, squareEdgeLength, calibration.cameraMatrix, calibration.distortionCoefficients);             // Each camera on its own first
+    double rightError = cameraCalibration(rightCorners, calibration.imageSize, boardSize, squareEdgeLength, stereo.rightCameraMatrix, stereo.rightDistortionCoefficients);
+    cout << "   Left camera RMS: " << calibration.reprojectionError << " px, right camera RMS: " << rightError << " px" << endl;
+
+    vector<vector<Point3f>> worldSpaceCornerPoints(1);
+    createKnownBoardPosition(boardSize, squareEdgeLength, worldSpaceCornerPoints[0]);
+    worldSpaceCornerPoints.resize(leftPairCorners.size(), worldSpaceCornerPoints[0]);
+
+    Mat essentialMatrix, fundamentalMatrix;
+    stereo.reprojectionError = stereoCalibrate(worldSpaceCornerPoints, leftPairCorners, rightPairCorners,
+                                               calibration.cameraMatrix, calibration.distortionCoefficients, stereo.rightCameraMatrix, stereo.rightDistortionCoefficients,
+                                               calibration.imageSize, stereo.rotation, stereo.translation, essentialMatrix, fundamentalMatrix, CALIB_FIX_INTRINSIC);   // Only the pose between the cameras is left to find
+
+    computeRectificationMaps(calibration);                                  // Rectification and its maps are computed once, here
+    return true;
 }
 
 int main(int argv, char** argc)
 {
-    Mat frame;                                                  // Define frame as matrix
-
-    Mat cameraMatrix = Mat::eye(3, 3, CV_64F);                  // Define camera calibration matrix
+    const String keys =
+        "{help h |                                    | print this message }"
+        "{images | ../calibration_images/calib_*.jpeg | calibration images }"
+        "{stereo |                                    | calibrate a camera pair from the left and right images }"
+        "{left   | ../calibration_images/left_*.jpeg  | left camera images (stereo) }"
+        "{right  | ../calibration_images/right_*.jpeg | right camera images (stereo, same order as the left ones) }"
+        "{cache  | ../calibration_images/cornerCache  | file where the corner search results are kept between runs }"
+        "{report |                                    | per-view errors, outlier rejection and uncertainty of the intrinsics }"
+        "{sigmas | 3                                  | reject the views whose error is this many standard deviations above the median (--report) }"
+        "{subset | 0                                  | pick this many well spread views to recalibrate from later (--report) }"
+        "{output | ../cameraCalibration.bin           | binary calibration file }"
+        "{text   | ../cameraCalibration.yml           | human readable copy of the calibration }";
+
+    CommandLineParser parser(argv, argc, keys);
+    if (parser.has("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
 
-    Mat distortionCoefficients;                                   // Define distance coefficients matrix
+    TRACE_START("calibrate");                                   // Only with the THREEDVIS_TRACE build option
 
-    vector<Mat> savedImages;                                    // Define vector of savedImages for camera calibration
+    bool stereo = parser.has("stereo");
 
-    vector<vector<Point2f>> markerCorners, rejectedCandidates;
+    Mat cameraMatrix = Mat::eye(3, 3, CV_64F);                  // Define camera calibration matrix
 
     vector<cv::String> fn;                                      // Automatically detect how many images there are in calibration_images directory
-    glob("../calibration_images/calib_*.jpeg", fn, false);      // Automatically detect how many images there are in calibration_images directory
+    size_t numberLeftImages = 0;
+    if (stereo)                                                 // Left images first, then the right ones, so both are searched in the same parallel pass
+    {
+        vector<cv::String> rightImages;
+        glob(parser.get<String>("left"), fn, false);
+        glob(parser.get<String>("right"), rightImages, false);
+
+        if (fn.size() != rightImages.size())
+        {
+            cout << fn.size() << " left images but " << rightImages.size() << " right images, they have to come in pairs. Exiting program..." << endl;
+            return -1;
+        }
+        numberLeftImages = fn.size();
+        fn.insert(fn.end(), rightImages.begin(), rightImages.end());
+    }
+    else
+    {
+        glob(parser.get<String>("images"), fn, false);          // Automatically detect how many images there are in calibration_images directory
+    }
 
-    vector<Mat> images;                                         // Automatically detect how many images there are in calibration_images directory
     size_t numberCalibrationImages = fn.size();                 // Automatically detect how many images there are in calibration_images directory
 
-    for (size_t n = 0; n < numberCalibrationImages; n++)        // Loop through images in calibration_images directory
-    {
-        std::string calibrationImagePath = "../calibration_images/calib_" + to_string(n) + ".jpeg";     // Define name of image for current iteration as we loop through them
-        frame = imread(calibrationImagePath, IMREAD_COLOR);                                             // Read image and import it into the "frame" matrix
+    String cachePath = parser.get<String>("cache");
+    CornerCache cache;
+    cache.load(cachePath, chessboardDimensions);                // Results of the previous runs (if any, and if made for the same board)
+
+    vector<ChessboardView> views;
+    size_t cachedImages = findAllChessboardCorners(fn, cache, views);   // Search every image that is not in the cache, in parallel
 
-        if(!frame.data)                                         // If there is no data in the frame, exit the program
+    vector<vector<Point2f>> foundCorners;                       // Corners of the images where the chessboard was found
+    vector<string> foundPaths;                                  // And where they came from, for the report
+    Size imageSize;
+
+    for (const ChessboardView& view : views)                    // Report in the same order as the images
+    {
+        if (view.imageSize.area() == 0)                         // If there is no data in the frame, exit the program
         {
-            cout << "No input image detected, exiting program..." << endl;
+            cout << "No input image detected (" << view.path << "), exiting program..." << endl;
             return -1;
         }
 
-        vector<Vec2f> foundPoints;                              // Define vector where the found points are on the image
+        cache.store(view);
 
-        bool found = findChessboardCorners(frame, chessboardDimensions, foundPoints, CALIB_CB_NORMALIZE_IMAGE);     // Use findChessboardCorners function (built into OpenCV) to find points on chessboard and put coordinates into foundPoint vector
+        if (view.found)                                         // If the chessboard is found in the current frame...
+        {
+            foundCorners.push_back(view.corners);
+            foundPaths.push_back(view.path);
+            imageSize = view.imageSize;
+            cout << "   " << view.path << ": chessboard found. Number of saved images: " << foundCorners.size() << endl;
+        }
+        else
+        {
+            cout << "   " << view.path << ": no chessboard found in this frame!" << endl;
+        }
+    }
 
-        drawChessboardCorners(frame, chessboardDimensions, foundPoints, found);                 // Use drawChessboardCorners function (built into OpenCV) to draw chessboard corners on drawToFrame frame
+    if (!cache.save(cachePath, chessboardDimensions))           // Keep the results for the next run
+    {
+        cout << "Could not write the corner cache to " << cachePath << endl;
+    }
+
+    cout << numberCalibrationImages - cachedImages << " new image(s) searched, " << cachedImages << " taken from the cache" << endl;
+
+    if (foundCorners.empty())
+    {
+        cout << "No chessboard found, cannot calibrate." << endl;
+        return -1;
+    }
+
+    CameraCalibration calibration;
 
-        if (found)                                                                              // If the chessboard is found in the current frame...
+    if (stereo)
+    {
+        cout << "Starting stereo calibration with " << numberLeftImages << " image pairs..." << endl;
+        vector<ChessboardView> leftViews(views.begin(), views.begin() + numberLeftImages), rightViews(views.begin() + numberLeftImages, views.end());
+
+        if (!stereoCameraCalibration(leftViews, rightViews, chessboardDimensions, calibrationSquareDimension, calibration))
+        {
+            cout << "No image pair where both cameras see the chessboard, cannot calibrate." << endl;
+            return -1;
+        }
+        cout << "Camera pair calibrated! Stereo RMS reprojection error: " << calibration.stereo.reprojectionError << " px, baseline: " << norm(calibration.stereo.translation) << " m" << endl;
+    }
+    else
+    {
+        cout << foundCorners.size() << " chessboards found out of " << numberCalibrationImages << " images, starting calibration..." << endl;    // Output message to inform the program has successfully exited the loop and started calibrating
+        calibration.cameraMatrix = cameraMatrix;
+        calibration.imageSize = imageSize;
+        if (parser.has("report"))
         {
-            Mat temp;                                                                           // Create a temporary matrix
-            frame.copyTo(temp);                                                                 // Copy the frame to the temporary matrix
-            savedImages.push_back(temp);                                                        // Add the temporary frame to the list of saved images
-            cout << "   Image saved. Number of saved images: " << savedImages.size() << endl;   // Output message to confirm that the image was saved
-        } else {
-            cout << "   No chessboard found in this frame!" << endl;                            // Output message telling us that the chessboard was not found in that frame
+            CalibrationReportSettings settings;
+            settings.outlierSigmas = parser.get<double>("sigmas");
+            settings.subsetSize = parser.get<int>("subset");
+
+            CalibrationReport report;
+            TRACE_SCOPE("calibrateWithReport");
+            calibration.reprojectionError = calibrateWithReport(foundCorners, imageSize, chessboardDimensions, calibrationSquareDimension, settings, calibration.cameraMatrix, calibration.distortionCoefficients, report);
+            printCalibrationReport(cout, report, foundPaths);
+            cout << "Camera calibrated using " << report.keptViews() << " images! RMS reprojection error: " << calibration.reprojectionError << " px" << endl;
+        }
+        else
+        {
+            calibration.reprojectionError = cameraCalibration(foundCorners, imageSize, chessboardDimensions, calibrationSquareDimension, calibration.cameraMatrix, calibration.distortionCoefficients);   // Run cameraCalibration function
+            cout << "Camera calibrated using " << foundCorners.size() << " images! RMS reprojection error: " << calibration.reprojectionError << " px" << endl;    // Output message to confirm that the camera parameters have been found using the provided saved images
         }
-
     }
 
-    cout << savedImages.size() << " chessboards found out of " << numberCalibrationImages << " images, starting calibration..." << endl;    // Output message to inform the program has successfully exited the loop and started calibrating
-    cameraCalibration(savedImages, chessboardDimensions, calibrationSquareDimension, cameraMatrix, distortionCoefficients);   // Run cameraCalibration function
-    cout << "Camera calibrated using " << savedImages.size() << " images!" << endl;             // Output message to confirm that the camera parameters have been found using the provided saved images
-    saveCameraCalibration("../cameraCalibration", cameraMatrix, distortionCoefficients);          // Run saveCameraCalibration function to output to text file
-    cout << "Camera calibration saved!" << endl;;                                               // Output message to confirm that the camera parameters have been found using the provided saved images
+    computeUndistortionMaps(calibration);                       // Done once here so that the trackers can start without recomputing them
+
+    if (!saveCalibrationFile(parser.get<String>("output"), calibration) || !exportCalibrationText(parser.get<String>("text"), calibration))
+    {
+        cout << "Could not save the camera calibration!" << endl;
+        return -1;
+    }
+    cout << "Camera calibration saved!" << endl;                // Output message to confirm that the camera parameters have been saved
 
     return 0;
 }
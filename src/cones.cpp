@@ -0,0 +1,195 @@
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <cstdio>
+
+#include "core/CalibrationFile.hpp"
+#include "core/ConeRange.hpp"
+#include "core/ConeSegmentation.hpp"
+#include "core/DetectionPublisher.hpp"
+#include "core/FrameSource.hpp"
+#include "core/LatencyStats.hpp"
+#include "core/ObjectTracker.hpp"
+#include "core/Trace.hpp"
+
+using namespace std;
+using namespace cv;
+
+const Scalar coneDrawColors[] = {Scalar(255, 0, 0), Scalar(0, 255, 255), Scalar(0, 128, 255)};    // Blue, yellow, orange (BGR)
+
+void drawConeBlobs(Mat& frame, const vector<ConeBlob>& blobs) {         // Function to draw a box around every cone blob
+
+    for (const ConeBlob& blob : blobs) {
+        rectangle(frame, blob.boundingBox, coneDrawColors[blob.coneClass - 1], 2);
+    }
+}
+
+void drawConeRanges(Mat& frame, const vector<ConeBlob>& blobs, const vector<ConeRange>& ranges, const vector<int>& trackIDs) {   // Function to write the range (and track) of every cone above its box
+
+    char rangeText[32];                                                 // Short enough for the small string buffer
+    for (size_t i = 0; i < blobs.size() && i < ranges.size(); i++) {
+        if (i < trackIDs.size()) {
+            snprintf(rangeText, sizeof(rangeText), "#%d %.1f m", trackIDs[i], ranges[i].range);
+        } else {
+            snprintf(rangeText, sizeof(rangeText), "%.1f m", ranges[i].range);
+        }
+        putText(frame, rangeText, blobs[i].boundingBox.tl() - Point(0, 4), FONT_HERSHEY_SIMPLEX, 0.5, coneDrawColors[blobs[i].coneClass - 1], 1);
+    }
+}
+
+int main(int argv, char** argc) {
+
+    const String keys =
+        "{help h        |                       | print this message }"
+        "{video         | ../videos/test-40.mov | video or recorded session to look for cones in }"
+        "{realtime      |                       | replay a recorded session at its recorded pace }"
+        "{min-area      | 30                    | smallest blob kept [px] }"
+        "{headless      |                       | do not open any window, only print the timings }"
+        "{publish       |                       | publish the cone blobs to this shared memory stream (e.g. /3dvis-detections) }"
+        "{calibration   |                       | binary camera calibration, to estimate the range and bearing of every cone }"
+        "{camera-height | 0                     | height of the camera above the ground [m] (0 = ranges from the cone heights only) }"
+        "{camera-pitch  | 0                     | downward tilt of the camera [deg] }"
+        "{camera-roll   | 0                     | roll of the camera, right side down [deg] }"
+        "{large-orange  |                       | the orange cones are the big ones (start and finish) }"
+        "{ranges        |                       | print the range and bearing of every cone }"
+        "{object-tracks |                       | follow the cones across frames with Kalman filtered tracks (needs --calibration) }";
+
+    CommandLineParser parser(argv, argc, keys);
+    if (parser.has("help")) {
+        parser.printMessage();
+        return 0;
+    }
+
+    TRACE_START("cones");                                               // Only with the THREEDVIS_TRACE build option
+
+    bool headless = parser.has("headless");
+
+    unique_ptr<FrameSource> source = openFrameSource(parser.get<String>("video"), parser.has("realtime"));     // Video file or recorded session
+
+    if (!source) {                                                      // If we cannot open the video, exit the program
+        return -1;
+    }
+
+    DetectionPublisher publisher;
+    if (parser.has("publish") && !publisher.open(parser.get<String>("publish"))) {
+        cout << publisher.error() << endl;
+        return -1;
+    }
+
+    ConeSegmenter segmenter;
+    segmenter.minimumArea = parser.get<int>("min-area");
+
+    MappedCalibration calibrationFile;                                  // Mapped for the whole run (the undistortion lookup points into it)
+    unique_ptr<ConeRangeEstimator> ranger;                              // Only with a calibration
+    if (parser.has("calibration")) {
+        if (!calibrationFile.open(parser.get<String>("calibration"))) {
+            cout << calibrationFile.error() << ", exiting program..." << endl;
+            return -1;
+        }
+
+        const CameraCalibration& calibration = calibrationFile.calibration();
+        const double degrees = CV_PI / 180.0;
+        GroundPlane ground;
+        if (parser.get<double>("camera-height") > 0.0) {
+            ground = GroundPlane(parser.get<double>("camera-height"), parser.get<double>("camera-pitch") * degrees, parser.get<double>("camera-roll") * degrees);
+        }
+
+        ranger.reset(new ConeRangeEstimator(CameraIntrinsics(calibration.cameraMatrix), calibration.distortionCoefficients, ground));
+        if (!calibration.cornerLookup.empty()) {                        // Use the undistortion lookup computed by calibrate
+            CornerUndistorter undistorter;
+            undistorter.adopt(calibration.cornerLookup, calibration.imageSize, calibration.cornerGridStep);
+            ranger->useUndistorter(undistorter);
+        }
+        if (parser.has("large-orange")) {
+            ranger->setGeometry(CONE_ORANGE, largeConeGeometry);
+        }
+    }
+    bool trackCones = parser.has("object-tracks");
+    if (trackCones && !ranger) {
+        cout << "Tracking the cones needs their positions, give a --calibration" << endl;
+        return -1;
+    }
+
+    bool printRanges = parser.has("ranges");
+    if (printRanges) {
+        cout << "frame,timestampMs,class,rangeM,bearingDeg,onGround,track" << endl;
+    }
+
+    Mat frame;
+    double timestamp;
+    int frameIndex = 0;
+    vector<ConeBlob> blobs;
+    vector<ConeRange> ranges;
+    ObjectTracker coneTracker;
+    vector<ObjectDetection> coneDetections;
+    const vector<int> noTracks;                                         // Track of every cone, when they are not tracked
+    const vector<int> noMarkers;                                        // Only cones are published
+    const vector<vector<Point2f>> noCorners;
+    const vector<Vec3d> noPoses;
+    const vector<TrackedObject> noTrackedObjects;
+    LatencyHistogram segmentation, ranging, tracking;
+
+    while (source->read(frame, timestamp)) {
+        {
+            ScopedLatency timer(segmentation);
+            segmenter.segment(frame, blobs);                            // Classify every pixel and extract the blobs
+        }
+
+        if (ranger) {
+            {
+                ScopedLatency timer(ranging);
+                ranger->estimate(blobs, frame.size(), ranges);          // Every cone of the frame in one batch
+            }
+
+            if (trackCones) {                                           // Same cone, same track ID, from frame to frame
+                ScopedLatency timer(tracking);
+                coneDetections.clear();
+                for (const ConeRange& cone : ranges) {
+                    coneDetections.push_back({cone.coneClass, cone.position});
+                }
+                coneTracker.update(coneDetections, timestamp);
+            }
+
+            const vector<int>& trackIDs = trackCones ? coneTracker.detectionTracks() : noTracks;
+            for (size_t i = 0; printRanges && i < ranges.size(); i++) {
+                cout << frameIndex << "," << timestamp << "," << ranges[i].coneClass << "," << ranges[i].range << "," << ranges[i].bearing * 180.0 / CV_PI << "," << ranges[i].onGround << "," << (i < trackIDs.size() ? trackIDs[i] : -1) << endl;
+            }
+        }
+
+        if (publisher.isOpen()) {
+            publisher.publish(frameIndex, timestamp, noMarkers, noCorners, noPoses, noPoses, blobs, trackCones ? coneTracker.tracks() : noTrackedObjects);
+        }
+        frameIndex++;
+
+        if (!headless) {
+            drawConeBlobs(frame, blobs);
+            if (ranger) {
+                drawConeRanges(frame, blobs, ranges, trackCones ? coneTracker.detectionTracks() : noTracks);
+            }
+            putText(frame, "Number of cone blobs: " + to_string(blobs.size()), Point(20, 40), FONT_HERSHEY_SIMPLEX, 1, Scalar::all(255), 1, 8);
+
+            imshow("Cones", frame);
+            imshow("Cone classes", segmenter.mask() * 80);              // Stretch the labels so that they are visible
+
+            if (waitKey(1) == 27) {                                     // Escape stops the video
+                break;
+            }
+        }
+    }
+
+    if (trackCones) {
+        cout << "Cone tracking: " << tracking.count() << " frames, p50 " << tracking.percentileMilliseconds(0.5) << " ms, p99 " << tracking.percentileMilliseconds(0.99) << " ms, max " << tracking.maxMilliseconds() << " ms, " << coneTracker.tracksStarted() << " tracks started" << endl;
+    }
+    if (ranger) {
+        cout << "Cone ranging: " << ranging.count() << " frames, p50 " << ranging.percentileMilliseconds(0.5) << " ms, p99 " << ranging.percentileMilliseconds(0.99) << " ms, max " << ranging.maxMilliseconds() << " ms" << endl;
+    }
+    cout << "Cone segmentation: " << segmentation.count() << " frames, p50 " << segmentation.percentileMilliseconds(0.5) << " ms, p99 " << segmentation.percentileMilliseconds(0.99) << " ms, max " << segmentation.maxMilliseconds() << " ms" << endl;
+
+    return 0;
+}
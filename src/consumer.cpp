@@ -0,0 +1,87 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+
+#include "core/DetectionStream.hpp"
+#include "core/LatencyStats.hpp"
+
+using namespace std;
+
+/*
+    Test consumer of the detection stream: prints what ./aruco --publish or
+    ./cones --publish detects, frame by frame, and the latency from the
+    moment a record was published to the moment it was read here. Links
+    3dvis_stream only, no OpenCV, like any other consumer would.
+
+    Usage: ./consumer [stream name] [frames to read, 0 = until Ctrl-C]
+*/
+
+atomic<bool> stopRequested(false);
+
+void requestStop(int) {
+    stopRequested.store(true);
+}
+
+void printFrame(const StreamFrame& frame, double latencyMicroseconds) {
+
+    cout << "frame " << frame.frameIndex << " at " << frame.timestampMilliseconds << " ms: " << frame.markerCount << " marker(s), " << frame.coneCount << " cone(s), read after " << latencyMicroseconds << " us" << endl;
+
+    for (int i = 0; i < frame.markerCount; i++) {
+        const StreamMarker& marker = frame.markers[i];
+        cout << "   marker " << marker.id;
+        if (marker.hasPose) {
+            cout << " at (" << marker.translation[0] << ", " << marker.translation[1] << ", " << marker.translation[2] << ") m";
+        }
+        cout << endl;
+    }
+
+    for (int i = 0; i < frame.trackCount; i++) {
+        const StreamTrack& track = frame.tracks[i];
+        cout << "   track " << track.trackId << " (label " << track.label << ") at (" << track.position[0] << ", " << track.position[1] << ", " << track.position[2] << ") m, "
+             << track.age << " frames old, confidence " << track.confidence << (track.missed > 0 ? ", hidden" : "") << endl;
+    }
+}
+
+int main(int argv, char** argc) {
+
+    string name = argv > 1 ? argc[1] : defaultDetectionStream;
+    long framesToRead = argv > 2 ? atol(argc[2]) : 0;
+
+    signal(SIGINT, requestStop);
+
+    DetectionSubscriber subscriber;
+    while (!subscriber.open(name)) {                                    // Wait for the publisher to start
+        if (stopRequested.load()) {
+            cout << subscriber.error() << endl;
+            return -1;
+        }
+        this_thread::sleep_for(chrono::milliseconds(100));
+    }
+
+    cout << "Reading " << name << ", Ctrl-C to stop" << endl;
+
+    StreamFrame frame;                                                  // About 9 kB, reused for every frame
+    LatencyHistogram publishToRead;
+    long framesRead = 0;
+
+    while (!stopRequested.load() && (framesToRead == 0 || framesRead < framesToRead)) {
+        if (!subscriber.next(frame)) {
+            this_thread::yield();                                       // Poll: a blocking wait would cost more than the copy itself
+            continue;
+        }
+
+        chrono::steady_clock::duration latency = chrono::steady_clock::now().time_since_epoch() - chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, milli>(frame.publishMilliseconds));
+        publishToRead.record(latency);
+        printFrame(frame, chrono::duration<double, micro>(latency).count());
+        framesRead++;
+    }
+
+    cout << "Publish to read: " << publishToRead.count() << " frames, p50 " << publishToRead.percentileMilliseconds(0.5) * 1000.0 << " us, p99 " << publishToRead.percentileMilliseconds(0.99) * 1000.0 << " us, max " << publishToRead.maxMilliseconds() * 1000.0 << " us" << endl;
+    cout << "Frames overwritten before they were read: " << subscriber.dropped() << endl;
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "AllocationCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+static thread_local uint64_t threadAllocations = 0;    // Plain value: safe to touch from inside operator new
+static atomic<uint64_t> totalAllocations(0);
+
+uint64_t threadAllocationCount() {
+    return threadAllocations;
+}
+
+uint64_t totalAllocationCount() {
+    return totalAllocations.load(memory_order_relaxed);
+}
+
+static void* countedAllocation(size_t size) {
+
+    threadAllocations++;
+    totalAllocations.fetch_add(1, memory_order_relaxed);
+    return malloc(size == 0 ? 1 : size);
+}
+
+void* operator new(size_t size) {
+    void* pointer = countedAllocation(size);
+    if (pointer == nullptr) {
+        throw bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    return countedAllocation(size);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    return countedAllocation(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, const nothrow_t&) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer, const nothrow_t&) noexcept {
+    free(pointer);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/*
+    Heap allocation counter. Linking AllocationCounter.cpp into an executable
+    replaces the global operator new/delete with versions that count every
+    allocation, per thread and in total, before forwarding to malloc/free.
+    cv::Mat buffers are counted too (every buffer comes with a UMatData that
+    is allocated with new); OpenCV's own scratch buffers (cv::AutoBuffer,
+    fastMalloc) and the video decoder's are not.
+
+    Used to check that the steady-state loop of a pipeline stage does not
+    allocate, since allocator jitter shows up as p99 latency spikes.
+*/
+
+uint64_t threadAllocationCount();       // Allocations made by the calling thread so far
+uint64_t totalAllocationCount();        // Allocations made by every thread so far
+
+class AllocationStats {                 // Allocations per frame of one pipeline stage, shared by the workers of the stage
+public:
+    AllocationStats() {}
+
+    AllocationStats(const AllocationStats&) = delete;
+    AllocationStats& operator=(const AllocationStats&) = delete;
+
+    void record(uint64_t allocations) {
+        frameCount.fetch_add(1, std::memory_order_relaxed);
+        allocationCount.fetch_add(allocations, std::memory_order_relaxed);
+        if (allocations > 0) {
+            allocatingFrameCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t frames() const { return frameCount.load(std::memory_order_relaxed); }
+    uint64_t allocations() const { return allocationCount.load(std::memory_order_relaxed); }
+    uint64_t allocatingFrames() const { return allocatingFrameCount.load(std::memory_order_relaxed); }   // Frames that allocated at least once
+    double perFrame() const { return frames() > 0 ? (double)allocations() / frames() : 0.0; }
+
+private:
+    std::atomic<uint64_t> frameCount{0};
+    std::atomic<uint64_t> allocationCount{0};
+    std::atomic<uint64_t> allocatingFrameCount{0};
+};
+
+class ScopedAllocations {               // Records the allocations made by this thread during its lifetime
+public:
+    explicit ScopedAllocations(AllocationStats& target, bool enabled = true) : stats(target), active(enabled), start(threadAllocationCount()) {}
+    ~ScopedAllocations() {
+        if (active) {
+            stats.record(threadAllocationCount() - start);
+        }
+    }
+
+    ScopedAllocations(const ScopedAllocations&) = delete;
+    ScopedAllocations& operator=(const ScopedAllocations&) = delete;
+
+private:
+    AllocationStats& stats;
+    bool active;                        // False during warm-up, while the buffers are still growing
+    uint64_t start;
+};
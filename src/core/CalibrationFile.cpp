@@ -0,0 +1,347 @@
+#include "CalibrationFile.hpp"
+#include "MarkerPose.hpp"
+
+#include <opencv2/calib3d.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+static_assert(sizeof(CalibrationFileHeader) % 8 == 0, "the checksum walks the header in 8 byte words");
+static_assert(sizeof(CalibrationSection) % 8 == 0, "sections must keep the data aligned");
+
+static const uint64_t checksumSeed = 14695981039346656037ULL;
+static const size_t sectionAlignment = 64;
+
+static uint64_t checksum64(const unsigned char* bytes, size_t n, uint64_t hash) {     // FNV-1a over 64-bit words (and bytewise over the tail)
+
+    size_t words = n / 8;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t word;
+        memcpy(&word, bytes + 8 * i, 8);
+        hash = (hash ^ word) * 1099511628211ULL;
+    }
+    for (size_t i = words * 8; i < n; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t fileChecksum(const unsigned char* file, size_t n) {                     // Checksum of a whole file, with the checksum field read as zero
+
+    CalibrationFileHeader header;
+    memcpy(&header, file, sizeof(header));
+    header.checksum = 0;
+
+    uint64_t hash = checksum64((const unsigned char*)&header, sizeof(header), checksumSeed);
+    return checksum64(file + sizeof(header), n - sizeof(header), hash);
+}
+
+template <typename Calibration, typename Visitor>
+static void forEachSection(Calibration& calibration, Visitor visit) {                   // Every matrix stored as a section, with its id
+
+    visit(SECTION_UNDISTORT_MAP1, calibration.undistortMap1);
+    visit(SECTION_UNDISTORT_MAP2, calibration.undistortMap2);
+    visit(SECTION_CORNER_LOOKUP, calibration.cornerLookup);
+
+    visit(SECTION_STEREO_RIGHT_CAMERA_MATRIX, calibration.stereo.rightCameraMatrix);
+    visit(SECTION_STEREO_RIGHT_DISTORTION, calibration.stereo.rightDistortionCoefficients);
+    visit(SECTION_STEREO_ROTATION, calibration.stereo.rotation);
+    visit(SECTION_STEREO_TRANSLATION, calibration.stereo.translation);
+    visit(SECTION_STEREO_LEFT_RECTIFICATION, calibration.stereo.leftRectification);
+    visit(SECTION_STEREO_RIGHT_RECTIFICATION, calibration.stereo.rightRectification);
+    visit(SECTION_STEREO_LEFT_PROJECTION, calibration.stereo.leftProjection);
+    visit(SECTION_STEREO_RIGHT_PROJECTION, calibration.stereo.rightProjection);
+    visit(SECTION_STEREO_DISPARITY_TO_DEPTH, calibration.stereo.disparityToDepth);
+    visit(SECTION_STEREO_LEFT_MAP1, calibration.stereo.leftRectifyMap1);
+    visit(SECTION_STEREO_LEFT_MAP2, calibration.stereo.leftRectifyMap2);
+    visit(SECTION_STEREO_RIGHT_MAP1, calibration.stereo.rightRectifyMap1);
+    visit(SECTION_STEREO_RIGHT_MAP2, calibration.stereo.rightRectifyMap2);
+}
+
+static size_t alignUp(size_t value) {
+    return (value + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+}
+
+void computeUndistortionMaps(CameraCalibration& calibration) {
+
+    CV_Assert(!calibration.cameraMatrix.empty() && calibration.imageSize.area() > 0);
+
+    initUndistortRectifyMap(calibration.cameraMatrix, calibration.distortionCoefficients, Mat(), calibration.cameraMatrix,
+                            calibration.imageSize, CV_16SC2, calibration.undistortMap1, calibration.undistortMap2);     // Fixed-point maps, the fastest ones for remap()
+
+    CornerUndistorter undistorter;
+    undistorter.create(calibration.cameraMatrix, calibration.distortionCoefficients, calibration.imageSize);
+    calibration.cornerLookup = undistorter.lookupGrid();
+    calibration.cornerGridStep = undistorter.gridStep();
+}
+
+void computeRectificationMaps(CameraCalibration& calibration) {
+
+    StereoCalibration& stereo = calibration.stereo;
+    CV_Assert(!stereo.empty() && !stereo.rotation.empty() && !stereo.translation.empty());
+
+    stereoRectify(calibration.cameraMatrix, calibration.distortionCoefficients, stereo.rightCameraMatrix, stereo.rightDistortionCoefficients,
+                  calibration.imageSize, stereo.rotation, stereo.translation,
+                  stereo.leftRectification, stereo.rightRectification, stereo.leftProjection, stereo.rightProjection, stereo.disparityToDepth,
+                  CALIB_ZERO_DISPARITY, 0);                                             // Keep only valid pixels, principal points aligned
+
+    initUndistortRectifyMap(calibration.cameraMatrix, calibration.distortionCoefficients, stereo.leftRectification, stereo.leftProjection,
+                            calibration.imageSize, CV_16SC2, stereo.leftRectifyMap1, stereo.leftRectifyMap2);
+    initUndistortRectifyMap(stereo.rightCameraMatrix, stereo.rightDistortionCoefficients, stereo.rightRectification, stereo.rightProjection,
+                            calibration.imageSize, CV_16SC2, stereo.rightRectifyMap1, stereo.rightRectifyMap2);
+}
+
+bool saveCalibrationFile(const string& name, const CameraCalibration& calibration) {
+
+    Mat cameraMatrix, distortion;
+    calibration.cameraMatrix.convertTo(cameraMatrix, CV_64F);
+    calibration.distortionCoefficients.convertTo(distortion, CV_64F);
+    CV_Assert(cameraMatrix.total() == 9 && distortion.total() <= 14);
+
+    CalibrationFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, calibrationFileMagic, sizeof(header.magic));
+    header.version = calibrationFileVersion;
+    header.imageWidth = calibration.imageSize.width;
+    header.imageHeight = calibration.imageSize.height;
+    header.reprojectionError = calibration.reprojectionError;
+    header.distortionCount = (uint32_t)distortion.total();
+    header.cornerGridStep = calibration.cornerGridStep;
+    memcpy(header.cameraMatrix, cameraMatrix.ptr<double>(), 9 * sizeof(double));
+    if (!distortion.empty()) {
+        memcpy(header.distortion, distortion.ptr<double>(), distortion.total() * sizeof(double));
+    }
+
+    struct Payload { uint32_t id; Mat matrix; };
+    vector<Payload> payloads;                                                           // Only the matrices that were actually computed
+    forEachSection(calibration, [&](uint32_t id, const Mat& matrix) {
+        if (!matrix.empty()) {
+            payloads.push_back({id, matrix});
+        }
+    });
+    if (!calibration.stereo.empty()) {
+        payloads.push_back({SECTION_STEREO_REPROJECTION_ERROR, Mat(1, 1, CV_64F, Scalar(calibration.stereo.reprojectionError))});
+    }
+
+    header.sectionCount = (uint32_t)payloads.size();
+
+    vector<CalibrationSection> sections(payloads.size());
+    size_t offset = alignUp(sizeof(header) + sections.size() * sizeof(CalibrationSection));
+    for (size_t i = 0; i < payloads.size(); i++) {
+        const Mat& matrix = payloads[i].matrix;
+        sections[i].id = payloads[i].id;
+        sections[i].type = matrix.type();
+        sections[i].rows = matrix.rows;
+        sections[i].cols = matrix.cols;
+        sections[i].offset = offset;
+        sections[i].bytes = matrix.total() * matrix.elemSize();
+        offset = alignUp(offset + sections[i].bytes);
+    }
+    header.fileSize = offset;
+
+    vector<unsigned char> file(offset, 0);                                              // Build the whole file in memory so the checksum can go in the header
+    memcpy(file.data(), &header, sizeof(header));
+    if (!sections.empty()) {
+        memcpy(file.data() + sizeof(header), sections.data(), sections.size() * sizeof(CalibrationSection));
+    }
+    for (size_t i = 0; i < payloads.size(); i++) {
+        Mat continuous = payloads[i].matrix.isContinuous() ? payloads[i].matrix : payloads[i].matrix.clone();
+        memcpy(file.data() + sections[i].offset, continuous.data, sections[i].bytes);
+    }
+
+    header.checksum = fileChecksum(file.data(), file.size());
+    memcpy(file.data(), &header, sizeof(header));
+
+    ofstream outStream(name, ios::binary);
+    if (!outStream) {
+        return false;
+    }
+    outStream.write((const char*)file.data(), file.size());
+    return (bool)outStream;
+}
+
+bool exportCalibrationText(const string& name, const CameraCalibration& calibration) {
+
+    FileStorage fs(name, FileStorage::WRITE);
+    if (!fs.isOpened()) {
+        return false;
+    }
+
+    fs << "version" << (int)calibrationFileVersion;
+    fs << "imageWidth" << calibration.imageSize.width;
+    fs << "imageHeight" << calibration.imageSize.height;
+    fs << "reprojectionError" << calibration.reprojectionError;
+    fs << "cameraMatrix" << calibration.cameraMatrix;
+    fs << "distortionCoefficients" << calibration.distortionCoefficients;
+
+    if (!calibration.stereo.empty()) {
+        const StereoCalibration& stereo = calibration.stereo;
+        fs << "stereo" << "{";
+        fs << "reprojectionError" << stereo.reprojectionError;
+        fs << "rightCameraMatrix" << stereo.rightCameraMatrix;
+        fs << "rightDistortionCoefficients" << stereo.rightDistortionCoefficients;
+        fs << "rotation" << stereo.rotation;
+        fs << "translation" << stereo.translation;
+        fs << "leftProjection" << stereo.leftProjection;
+        fs << "rightProjection" << stereo.rightProjection;
+        fs << "disparityToDepth" << stereo.disparityToDepth;
+        fs << "}";
+    }
+    return true;
+}
+
+bool loadLegacyCalibration(const string& name, Mat& cameraMatrix, Mat& distortionCoefficients, bool showResults) {      // Function to load camera calibration matrix (old text format)
+
+    ifstream inStream(name);
+
+    if (inStream){
+        uint16_t rows;
+        uint16_t columns;
+
+        // Camera Matrix
+        inStream >> rows;
+        inStream >> columns;
+
+        cameraMatrix = Mat(rows, columns, CV_64F);                     // Rows first (Size takes the width first)
+
+        for (int r = 0; r < rows; r++){
+            for(int c = 0; c < columns; c++){
+                double read = 0.0f;
+                
+                inStream >> read;
+                cameraMatrix.at<double>(r, c) = read;
+                
+                if (showResults)
+                {
+                    cout << cameraMatrix.at<double>(r, c) << endl;
+                }
+            }
+        }
+
+        // Distance Coefficients
+        inStream >> rows;
+        inStream >> columns;
+
+        distortionCoefficients = Mat::zeros(rows, columns, CV_64F);
+
+        for (int r = 0; r < rows; r++){
+            for(int c = 0; c < columns; c++){
+                double read = 0.0f;
+
+                inStream >> read;
+
+                distortionCoefficients.at<double>(r, c) = read;
+                
+                if (showResults)
+                {
+                    cout << distortionCoefficients.at<double>(r, c) << endl;
+                }
+            }
+        }
+        inStream.close();
+        return true;
+
+    }
+
+    return false;
+}
+
+bool MappedCalibration::open(const string& name, bool verifyChecksum) {
+
+    close();
+    lastError.clear();
+
+    int fd = ::open(name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        lastError = "cannot open " + name;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(CalibrationFileHeader)) {
+        ::close(fd);
+        lastError = name + " is too small to be a calibration file";
+        return false;
+    }
+
+    size = (size_t)info.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);                                                                        // The mapping stays valid without the descriptor
+
+    if (mapped == MAP_FAILED) {
+        lastError = "cannot map " + name;
+        size = 0;
+        return false;
+    }
+    data = mapped;
+
+    const unsigned char* bytes = (const unsigned char*)data;
+    const CalibrationFileHeader* header = (const CalibrationFileHeader*)bytes;
+
+    if (memcmp(header->magic, calibrationFileMagic, sizeof(header->magic)) != 0) {
+        lastError = name + " is not a calibration file";
+    } else if (header->version != calibrationFileVersion) {
+        lastError = name + " has version " + to_string(header->version) + ", expected " + to_string(calibrationFileVersion);
+    } else if (header->fileSize != size || header->distortionCount > 14
+               || sizeof(CalibrationFileHeader) + header->sectionCount * sizeof(CalibrationSection) > size) {
+        lastError = name + " is truncated or corrupt";
+    } else if (verifyChecksum && fileChecksum(bytes, size) != header->checksum) {
+        lastError = name + " failed its checksum";
+    }
+
+    if (!lastError.empty()) {
+        close();
+        return false;
+    }
+
+    views = CameraCalibration();                                                        // Everything below is a view into the mapping, nothing is copied
+    views.cameraMatrix = Mat(3, 3, CV_64F, (void*)header->cameraMatrix);
+    views.distortionCoefficients = Mat((int)header->distortionCount, 1, CV_64F, (void*)header->distortion);
+    views.imageSize = Size(header->imageWidth, header->imageHeight);
+    views.reprojectionError = header->reprojectionError;
+    views.cornerGridStep = header->cornerGridStep;
+
+    const CalibrationSection* sections = (const CalibrationSection*)(bytes + sizeof(CalibrationFileHeader));
+    for (uint32_t i = 0; i < header->sectionCount; i++) {
+        const CalibrationSection& section = sections[i];
+        size_t expectedBytes = (size_t)section.rows * section.cols * CV_ELEM_SIZE(section.type);
+
+        if (section.offset + section.bytes > size || section.bytes != expectedBytes) {
+            lastError = name + " has a corrupt section";
+            close();
+            return false;
+        }
+
+        Mat view(section.rows, section.cols, section.type, (void*)(bytes + section.offset));
+        if (section.id == SECTION_STEREO_REPROJECTION_ERROR) {
+            views.stereo.reprojectionError = view.at<double>(0, 0);
+        }
+        forEachSection(views, [&](uint32_t id, Mat& matrix) {          // Sections added by newer versions match nothing and are skipped
+            if (id == section.id) {
+                matrix = view;
+            }
+        });
+    }
+
+    return true;
+}
+
+void MappedCalibration::close() {
+
+    views = CameraCalibration();
+    if (data != nullptr) {
+        munmap(data, size);
+        data = nullptr;
+    }
+    size = 0;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <string>
+
+/*
+    Camera calibration and everything derived from it.
+
+    The binary calibration file stores this structure so that it can be
+    memory-mapped and used directly: a fixed header with the intrinsics,
+    distortion, image size and reprojection error, followed by a table of
+    sections holding the precomputed undistortion maps. Opening it is one
+    mmap() and a checksum, no text parsing and no map computation.
+
+    File layout (native byte order, every section aligned to 64 bytes):
+
+        CalibrationFileHeader
+        CalibrationSection[sectionCount]
+        section data...
+*/
+
+struct StereoCalibration {                  // Second camera of a stereo pair, the main calibration is the left camera
+    cv::Mat rightCameraMatrix;              // 3x3, CV_64F
+    cv::Mat rightDistortionCoefficients;
+    cv::Mat rotation, translation;          // Right camera relative to the left one (stereoCalibrate)
+    cv::Mat leftRectification, rightRectification;  // 3x3 rectifying rotations (stereoRectify)
+    cv::Mat leftProjection, rightProjection;        // 3x4 projections in the rectified frame
+    cv::Mat disparityToDepth;               // 4x4 Q matrix
+    cv::Mat leftRectifyMap1, leftRectifyMap2, rightRectifyMap1, rightRectifyMap2;   // remap() maps to the rectified images
+    double reprojectionError = -1.0;        // RMS returned by stereoCalibrate
+
+    bool empty() const { return rightCameraMatrix.empty(); }
+};
+
+struct CameraCalibration {
+    cv::Mat cameraMatrix;                   // 3x3, CV_64F
+    cv::Mat distortionCoefficients;         // Nx1, CV_64F
+    cv::Size imageSize;
+    double reprojectionError = -1.0;        // RMS returned by calibrateCamera, negative if unknown
+
+    cv::Mat undistortMap1, undistortMap2;   // Full-frame undistortion for remap() (CV_16SC2 + CV_16UC1)
+    cv::Mat cornerLookup;                   // Inverse distortion grid used for marker corners (CV_32FC2)
+    int cornerGridStep = 0;
+
+    StereoCalibration stereo;               // Empty for a single camera
+};
+
+const char calibrationFileMagic[8] = {'3', 'D', 'V', 'I', 'S', 'C', 'A', 'L'};
+const uint32_t calibrationFileVersion = 1;
+
+struct CalibrationFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint64_t fileSize;
+    uint64_t checksum;                      // Of the whole file, computed with this field set to zero
+    int32_t imageWidth;
+    int32_t imageHeight;
+    double reprojectionError;
+    double cameraMatrix[9];
+    uint32_t distortionCount;
+    int32_t cornerGridStep;
+    double distortion[14];                  // Up to the 14 coefficients OpenCV supports
+};
+
+enum CalibrationSectionId : uint32_t {
+    SECTION_UNDISTORT_MAP1 = 1,
+    SECTION_UNDISTORT_MAP2 = 2,
+    SECTION_CORNER_LOOKUP = 3,
+
+    SECTION_STEREO_RIGHT_CAMERA_MATRIX = 16,    // Stereo sections, only present after a stereo calibration
+    SECTION_STEREO_RIGHT_DISTORTION = 17,
+    SECTION_STEREO_ROTATION = 18,
+    SECTION_STEREO_TRANSLATION = 19,
+    SECTION_STEREO_LEFT_RECTIFICATION = 20,
+    SECTION_STEREO_RIGHT_RECTIFICATION = 21,
+    SECTION_STEREO_LEFT_PROJECTION = 22,
+    SECTION_STEREO_RIGHT_PROJECTION = 23,
+    SECTION_STEREO_DISPARITY_TO_DEPTH = 24,
+    SECTION_STEREO_LEFT_MAP1 = 25,
+    SECTION_STEREO_LEFT_MAP2 = 26,
+    SECTION_STEREO_RIGHT_MAP1 = 27,
+    SECTION_STEREO_RIGHT_MAP2 = 28,
+    SECTION_STEREO_REPROJECTION_ERROR = 29      // 1x1, CV_64F
+};
+
+struct CalibrationSection {
+    uint32_t id;                            // CalibrationSectionId
+    int32_t type;                           // OpenCV type of the matrix (CV_16SC2, ...)
+    int32_t rows;
+    int32_t cols;
+    uint64_t offset;                        // From the start of the file
+    uint64_t bytes;
+};
+
+void computeUndistortionMaps(CameraCalibration& calibration);                              // Fill the remap maps and the corner lookup from the intrinsics
+void computeRectificationMaps(CameraCalibration& calibration);                             // Fill the stereo rectification and its remap maps from the stereo extrinsics
+
+bool saveCalibrationFile(const std::string& name, const CameraCalibration& calibration);   // Binary, memory-mappable
+bool exportCalibrationText(const std::string& name, const CameraCalibration& calibration); // YAML, for humans
+
+bool loadLegacyCalibration(const std::string& name, cv::Mat& cameraMatrix, cv::Mat& distortionCoefficients, bool showResults = false);   // Old one-value-per-line text format
+
+class MappedCalibration {                   // A binary calibration file mapped read-only into memory
+public:
+    MappedCalibration() {}
+    ~MappedCalibration() { close(); }
+
+    MappedCalibration(const MappedCalibration&) = delete;
+    MappedCalibration& operator=(const MappedCalibration&) = delete;
+
+    bool open(const std::string& name, bool verifyChecksum = true);
+    void close();
+
+    bool isOpen() const { return data != nullptr; }
+    const std::string& error() const { return lastError; }
+
+    const CameraCalibration& calibration() const { return views; } // Matrices point into the mapping: read-only, valid until close()
+
+private:
+    void* data = nullptr;
+    size_t size = 0;
+    CameraCalibration views;
+    std::string lastError;
+};
@@ -0,0 +1,274 @@
+#include "CalibrationReport.hpp"
+#include "Chessboard.hpp"
+#include "Parallel.hpp"
+
+#include <opencv2/calib3d.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+
+using namespace std;
+using namespace cv;
+
+int CalibrationReport::keptViews() const {
+
+    return (int)count_if(views.begin(), views.end(), [](const ViewError& view) { return !view.rejected; });
+}
+
+static double calibrateViews(const vector<Point3f>& board, const vector<vector<Point2f>>& corners, const vector<int>& indices, Size imageSize,
+                             Mat& cameraMatrix, Mat& distortionCoefficients, vector<Mat>& rotations, vector<Mat>& translations, Mat& intrinsicsDeviation) {   // calibrateCamera on some of the views
+
+    vector<vector<Point3f>> objectPoints(indices.size(), board);
+    vector<vector<Point2f>> imagePoints;
+    imagePoints.reserve(indices.size());
+    for (int i : indices) {
+        imagePoints.push_back(corners[i]);
+    }
+
+    cameraMatrix = Mat::eye(3, 3, CV_64F);
+    distortionCoefficients = Mat::zeros(8, 1, CV_64F);
+    Mat extrinsicsDeviation, perViewErrors;
+    return calibrateCamera(objectPoints, imagePoints, imageSize, cameraMatrix, distortionCoefficients, rotations, translations, intrinsicsDeviation, extrinsicsDeviation, perViewErrors);
+}
+
+static void measureViews(const vector<Point3f>& board, const vector<vector<Point2f>>& corners, const vector<int>& measured, const Mat& cameraMatrix, const Mat& distortionCoefficients,
+                         const vector<int>& fitted, const vector<Mat>& rotations, const vector<Mat>& translations, vector<ViewError>& views) {     // Reprojection error of every corner of the measured views
+
+    vector<int> fittedPosition(corners.size(), -1);                                 // Where the pose of a view is in rotations/translations
+    for (size_t p = 0; p < fitted.size(); p++) {
+        fittedPosition[fitted[p]] = (int)p;
+    }
+
+    parallelForRanges(Range(0, (int)measured.size()), [&](const Range& range) {     // Views are independent
+        vector<Point2f> projected;
+        for (int m = range.start; m < range.end; m++) {
+            int i = measured[m];
+            Mat rotation, translation;
+            if (fittedPosition[i] >= 0) {
+                rotation = rotations[fittedPosition[i]];
+                translation = translations[fittedPosition[i]];
+            } else {
+                solvePnP(board, corners[i], cameraMatrix, distortionCoefficients, rotation, translation);  // A view left out of the calibration has no pose yet
+            }
+
+            projectPoints(board, rotation, translation, cameraMatrix, distortionCoefficients, projected);
+
+            ViewError& view = views[i];
+            view.cornerErrors.resize(board.size());
+            view.maxCorner = 0.0;
+            double squares = 0.0;
+            for (size_t c = 0; c < board.size(); c++) {
+                Point2f difference = projected[c] - corners[i][c];
+                float error = sqrt(difference.x * difference.x + difference.y * difference.y);
+                view.cornerErrors[c] = error;
+                view.maxCorner = max(view.maxCorner, (double)error);
+                squares += error * error;
+            }
+            view.rms = sqrt(squares / board.size());
+        }
+    });
+}
+
+static double median(vector<double>& values) {                                     // Reorders values
+
+    size_t middle = values.size() / 2;
+    nth_element(values.begin(), values.begin() + middle, values.end());
+    return values[middle];
+}
+
+static double outlierThreshold(const vector<ViewError>& views, const vector<int>& kept, const CalibrationReportSettings& settings) {
+
+    vector<double> errors;
+    for (int i : kept) {
+        errors.push_back(views[i].rms);
+    }
+    double center = median(errors);
+
+    for (double& error : errors) {
+        error = fabs(error - center);
+    }
+    double sigma = 1.4826 * median(errors);                                         // Median absolute deviation, scaled to a standard deviation
+
+    return max(center + settings.outlierSigmas * sigma, settings.outlierFloor);
+}
+
+static vector<int> pickSubset(const vector<vector<Point2f>>& corners, const vector<int>& kept, const vector<Mat>& rotations, const vector<Mat>& translations,
+                              Size imageSize, const vector<ViewError>& views, int subsetSize) {     // Greedy farthest-point selection of well spread board poses
+
+    vector<double> distances;
+    for (const Mat& translation : translations) {
+        distances.push_back(translation.at<double>(2));
+    }
+    double typicalDistance = median(distances);
+
+    vector<Vec<double, 5>> features(kept.size());                                  // Board tilt, position in the image, distance
+    for (size_t p = 0; p < kept.size(); p++) {
+        Matx33d rotation;
+        Rodrigues(rotations[p], rotation);
+        Point2f center = accumulate(corners[kept[p]].begin(), corners[kept[p]].end(), Point2f(0, 0)) * (1.0f / corners[kept[p]].size());
+        features[p] = Vec<double, 5>(rotation(0, 2), rotation(1, 2),                // Board normal, seen from the camera
+                                     center.x / imageSize.width - 0.5, center.y / imageSize.height - 0.5,
+                                     log(max(translations[p].at<double>(2), 1e-6) / typicalDistance));
+    }
+
+    size_t first = 0;                                                               // Start from the view that fits best
+    for (size_t p = 1; p < kept.size(); p++) {
+        if (views[kept[p]].rms < views[kept[first]].rms) {
+            first = p;
+        }
+    }
+
+    vector<int> subset = {(int)first};
+    vector<double> nearest(kept.size(), numeric_limits<double>::max());            // Distance of every view to the closest one picked so far
+    while ((int)subset.size() < subsetSize) {
+        size_t farthest = 0;
+        for (size_t p = 0; p < kept.size(); p++) {
+            nearest[p] = min(nearest[p], norm(features[p] - features[subset.back()]));
+            if (nearest[p] > nearest[farthest]) {
+                farthest = p;
+            }
+        }
+        if (nearest[farthest] == 0.0) {                                             // Only duplicates of picked views are left
+            break;
+        }
+        subset.push_back((int)farthest);
+    }
+
+    for (int& p : subset) {                                                         // Positions in kept to view indices
+        p = kept[p];
+    }
+    sort(subset.begin(), subset.end());
+    return subset;
+}
+
+double calibrateWithReport(const vector<vector<Point2f>>& corners, Size imageSize, Size boardSize, float squareEdgeLength, const CalibrationReportSettings& settings,
+                           Mat& cameraMatrix, Mat& distortionCoefficients, CalibrationReport& report) {
+
+    vector<Point3f> board;
+    createKnownBoardPosition(boardSize, squareEdgeLength, board);
+
+    report = CalibrationReport();
+    report.views.assign(corners.size(), ViewError());
+
+    vector<int> everyView(corners.size());
+    iota(everyView.begin(), everyView.end(), 0);
+    vector<int> kept = everyView;
+    vector<Mat> rotations, translations;
+
+    for (report.iterations = 1; ; report.iterations++) {
+        report.rms = calibrateViews(board, corners, kept, imageSize, cameraMatrix, distortionCoefficients, rotations, translations, report.intrinsicsDeviation);
+        measureViews(board, corners, everyView, cameraMatrix, distortionCoefficients, kept, rotations, translations, report.views);   // Rejected views too, with the new intrinsics
+
+        if (report.iterations >= settings.maxIterations) {
+            break;
+        }
+
+        double threshold = outlierThreshold(report.views, kept, settings);
+        vector<int> stillKept;
+        for (int i : kept) {
+            if (report.views[i].rms <= threshold) {
+                stillKept.push_back(i);
+            }
+        }
+
+        if (stillKept.size() == kept.size() || (int)stillKept.size() < settings.minimumViews) {    // Nothing stands out, or too little would be left
+            break;
+        }
+
+        for (int i : kept) {
+            report.views[i].rejected = report.views[i].rms > threshold;
+        }
+        kept.swap(stillKept);
+    }
+
+    if (settings.subsetSize > 0 && settings.subsetSize < (int)kept.size()) {
+        vector<int> subset = pickSubset(corners, kept, rotations, translations, imageSize, report.views, settings.subsetSize);
+
+        vector<Mat> subsetRotations, subsetTranslations;
+        Mat subsetDeviation;
+        calibrateViews(board, corners, subset, imageSize, report.subsetCameraMatrix, report.subsetDistortionCoefficients, subsetRotations, subsetTranslations, subsetDeviation);
+
+        vector<ViewError> check(corners.size());                                   // Every kept view, seen through the subset calibration
+        measureViews(board, corners, kept, report.subsetCameraMatrix, report.subsetDistortionCoefficients, subset, subsetRotations, subsetTranslations, check);
+
+        double squares = 0.0;
+        for (int i : kept) {
+            squares += check[i].rms * check[i].rms;
+        }
+        report.subsetRms = sqrt(squares / kept.size());
+
+        for (int i : subset) {
+            report.views[i].inSubset = true;
+        }
+    }
+
+    checkCalibration(cameraMatrix, imageSize, report.intrinsicsDeviation, report.rms, report.warnings);
+    return report.rms;
+}
+
+void checkCalibration(const Mat& cameraMatrix, Size imageSize, const Mat& intrinsicsDeviation, double rms, vector<string>& warnings) {
+
+    char text[256];
+    double fx = cameraMatrix.at<double>(0, 0), fy = cameraMatrix.at<double>(1, 1);
+    double cx = cameraMatrix.at<double>(0, 2), cy = cameraMatrix.at<double>(1, 2);
+
+    if (rms > 1.0) {
+        snprintf(text, sizeof(text), "RMS reprojection error of %.3f px, a good calibration stays below 1 px", rms);
+        warnings.push_back(text);
+    }
+
+    if (fabs(fx / fy - 1.0) > 0.05) {
+        snprintf(text, sizeof(text), "fx (%.1f) and fy (%.1f) differ by %.1f%%, the pixels of our cameras are square", fx, fy, 100.0 * fabs(fx / fy - 1.0));
+        warnings.push_back(text);
+    }
+
+    if (imageSize.area() > 0 && (fabs(cx - 0.5 * imageSize.width) > 0.1 * imageSize.width || fabs(cy - 0.5 * imageSize.height) > 0.1 * imageSize.height)) {
+        snprintf(text, sizeof(text), "principal point (%.1f, %.1f) is far from the image center (%.1f, %.1f)", cx, cy, 0.5 * imageSize.width, 0.5 * imageSize.height);
+        warnings.push_back(text);
+    }
+
+    if (intrinsicsDeviation.total() >= 4) {
+        const double* deviation = intrinsicsDeviation.ptr<double>();               // fx, fy, cx, cy first
+        if (deviation[0] > 0.01 * fx || deviation[1] > 0.01 * fy) {
+            snprintf(text, sizeof(text), "focal length only known to %.1f%%, add views with more varied board tilts", 100.0 * max(deviation[0] / fx, deviation[1] / fy));
+            warnings.push_back(text);
+        }
+        if (imageSize.area() > 0 && (deviation[2] > 0.02 * imageSize.width || deviation[3] > 0.02 * imageSize.height)) {
+            snprintf(text, sizeof(text), "principal point only known to (%.1f, %.1f) px, add views with the board near the image corners", deviation[2], deviation[3]);
+            warnings.push_back(text);
+        }
+    }
+}
+
+void printCalibrationReport(ostream& out, const CalibrationReport& report, const vector<string>& viewNames) {
+
+    const char* intrinsicNames[] = {"fx", "fy", "cx", "cy", "k1", "k2", "p1", "p2", "k3"};
+
+    out << "Calibration report (" << report.iterations << " round(s), " << report.keptViews() << " of " << report.views.size() << " views kept):" << endl;
+    for (size_t i = 0; i < report.views.size(); i++) {
+        const ViewError& view = report.views[i];
+        out << "   " << (i < viewNames.size() ? viewNames[i] : to_string(i)) << ": RMS " << view.rms << " px, worst corner " << view.maxCorner << " px"
+            << (view.rejected ? ", REJECTED" : "") << (view.inSubset ? ", in subset" : "") << endl;
+    }
+
+    out << "RMS reprojection error: " << report.rms << " px" << endl;
+    if (!report.intrinsicsDeviation.empty()) {
+        out << "Standard deviation of the intrinsics:";
+        for (int k = 0; k < 9 && k < (int)report.intrinsicsDeviation.total(); k++) {
+            out << " " << intrinsicNames[k] << " " << report.intrinsicsDeviation.at<double>(k);
+        }
+        out << endl;
+    }
+
+    if (report.subsetRms >= 0.0) {
+        int subsetViews = (int)count_if(report.views.begin(), report.views.end(), [](const ViewError& view) { return view.inSubset; });
+        out << "Subset of " << subsetViews << " views: RMS " << report.subsetRms << " px over every kept view (" << report.rms << " px with all of them)" << endl;
+    }
+
+    for (const string& warning : report.warnings) {
+        out << "WARNING: " << warning << endl;
+    }
+}
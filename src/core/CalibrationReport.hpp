@@ -0,0 +1,61 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+    Calibration with a quality report. After every calibrateCamera run, the
+    reprojection error of each view and each corner is measured (views in
+    parallel); views whose error is far above the others (median plus a few
+    robust standard deviations) are rejected and the camera is calibrated
+    again without them, until no view stands out.
+
+    The report also holds the standard deviation of the intrinsics, as
+    estimated by calibrateCamera, and sanity checks on the result (focal
+    lengths that disagree, a principal point far from the image center...)
+    that catch a bad calibration before it ruins 3D positions.
+
+    Finally it can pick a small subset of the kept views that still spans
+    the board poses well (greedy farthest-point selection on board tilt,
+    position in the image and distance). The subset is calibrated on its
+    own and checked against every kept view, so later recalibrations can
+    use only those images.
+*/
+
+struct CalibrationReportSettings {
+    double outlierSigmas = 3.0;             // A view is rejected when its RMS error is above median + outlierSigmas * robust standard deviation...
+    double outlierFloor = 0.5;              // ...and above this [px], so that a uniformly good set loses nothing
+    int maxIterations = 5;                  // Calibrate / reject rounds
+    int minimumViews = 8;                   // Never reject below this many views
+    int subsetSize = 0;                     // Views to pick for the subset (0 = no subset)
+};
+
+struct ViewError {                          // Reprojection error of one view, with the final intrinsics
+    double rms = 0.0;                       // [px]
+    double maxCorner = 0.0;                 // Worst corner [px]
+    std::vector<float> cornerErrors;        // [px], in the order of the corners
+    bool rejected = false;                  // Dropped as an outlier (its pose then comes from solvePnP)
+    bool inSubset = false;
+};
+
+struct CalibrationReport {
+    double rms = -1.0;                      // Over the kept views, as returned by calibrateCamera [px]
+    int iterations = 0;
+    std::vector<ViewError> views;           // One per input view
+    cv::Mat intrinsicsDeviation;            // Standard deviation of fx, fy, cx, cy, k1, k2, p1, p2, k3...
+    cv::Mat subsetCameraMatrix, subsetDistortionCoefficients;      // Calibration from the subset alone, if one was picked
+    double subsetRms = -1.0;                // Error of the subset calibration over every kept view [px]
+    std::vector<std::string> warnings;      // What looks wrong with the calibration
+
+    int keptViews() const;
+};
+
+double calibrateWithReport(const std::vector<std::vector<cv::Point2f>>& corners, cv::Size imageSize, cv::Size boardSize, float squareEdgeLength, const CalibrationReportSettings& settings,
+                           cv::Mat& cameraMatrix, cv::Mat& distortionCoefficients, CalibrationReport& report);     // Calibrate on the views that are not outliers, returns the RMS error
+
+void checkCalibration(const cv::Mat& cameraMatrix, cv::Size imageSize, const cv::Mat& intrinsicsDeviation, double rms, std::vector<std::string>& warnings);   // Sanity checks, appends to warnings
+
+void printCalibrationReport(std::ostream& out, const CalibrationReport& report, const std::vector<std::string>& viewNames);
@@ -0,0 +1,78 @@
+#include "CameraIntrinsics.hpp"
+
+#include <opencv2/core/hal/intrin.hpp>
+
+using namespace std;
+using namespace cv;
+
+CameraIntrinsics::CameraIntrinsics(const Mat& cameraMatrix) {
+
+    CV_Assert(cameraMatrix.rows == 3 && cameraMatrix.cols == 3);
+
+    Mat asDouble;
+    cameraMatrix.convertTo(asDouble, CV_64F);
+    K = Matx33d((const double*)asDouble.data) * (1.0 / asDouble.at<double>(2, 2));     // Normalize so that the last element is one
+
+    double a = K(0, 0);             // Closed-form inverse of an upper triangular matrix with K(2, 2) == 1
+    double b = K(0, 1);
+    double c = K(0, 2);
+    double d = K(1, 1);
+    double e = K(1, 2);
+
+    inverseK = Matx33d(1/a, -b/(a*d), (b*e - c*d)/(a*d),
+                       0,   1/d,      -e/d,
+                       0,   0,        1);
+
+    float forward[5] = {(float)a, (float)b, (float)c, (float)d, (float)e};
+    float backward[5] = {(float)inverseK(0, 0), (float)inverseK(0, 1), (float)inverseK(0, 2), (float)inverseK(1, 1), (float)inverseK(1, 2)};
+    for (int i = 0; i < 5; i++) {
+        projectCoefficients[i] = forward[i];
+        backProjectCoefficients[i] = backward[i];
+    }
+}
+
+static void affineUpperTriangular(const float* m, const Point2f* input, Point2f* output, size_t count) {  // out = (m0*x + m1*y + m2, m3*y + m4) for every point
+
+    const float* in = (const float*)input;
+    float* out = (float*)output;
+    size_t i = 0;
+
+#if CV_SIMD
+    const size_t lanes = v_float32::nlanes;
+    v_float32 m0 = vx_setall_f32(m[0]), m1 = vx_setall_f32(m[1]), m2 = vx_setall_f32(m[2]);
+    v_float32 m3 = vx_setall_f32(m[3]), m4 = vx_setall_f32(m[4]);
+
+    for (; i + lanes <= count; i += lanes) {                            // Points are interleaved (x, y), split them into two registers
+        v_float32 x, y;
+        v_load_deinterleave(in + 2 * i, x, y);
+        v_float32 outX = v_fma(m0, x, v_fma(m1, y, m2));
+        v_float32 outY = v_fma(m3, y, m4);
+        v_store_interleave(out + 2 * i, outX, outY);
+    }
+#endif
+
+    for (; i < count; i++) {                                            // Remaining points
+        float x = in[2 * i];
+        float y = in[2 * i + 1];
+        out[2 * i] = m[0] * x + m[1] * y + m[2];
+        out[2 * i + 1] = m[3] * y + m[4];
+    }
+}
+
+void CameraIntrinsics::backProject(const Point2f* pixels, Point2f* normalized, size_t count) const {
+    affineUpperTriangular(backProjectCoefficients, pixels, normalized, count);
+}
+
+void CameraIntrinsics::project(const Point2f* normalized, Point2f* pixels, size_t count) const {
+    affineUpperTriangular(projectCoefficients, normalized, pixels, count);
+}
+
+void CameraIntrinsics::backProject(const vector<Point2f>& pixels, vector<Point2f>& normalized) const {
+    normalized.resize(pixels.size());
+    backProject(pixels.data(), normalized.data(), pixels.size());
+}
+
+void CameraIntrinsics::project(const vector<Point2f>& normalized, vector<Point2f>& pixels) const {
+    pixels.resize(normalized.size());
+    project(normalized.data(), pixels.data(), normalized.size());
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+/*
+    Pinhole intrinsics of a calibrated camera, built once when the
+    calibration is loaded. The inverse of the (upper triangular) camera
+    matrix is precomputed in a fixed-size Matx, and the batch kernels below
+    move whole arrays of points between pixel coordinates and normalized
+    image coordinates with SIMD, without any heap allocation.
+
+    A point (x, y) in normalized image coordinates is the direction (x, y, 1)
+    of the ray through the pixel, in the camera frame.
+*/
+
+class CameraIntrinsics {
+public:
+    CameraIntrinsics() : CameraIntrinsics(cv::Mat::eye(3, 3, CV_64F)) {}
+    explicit CameraIntrinsics(const cv::Mat& cameraMatrix);
+
+    const cv::Matx33d& matrix() const { return K; }
+    const cv::Matx33d& inverse() const { return inverseK; }
+
+    double fx() const { return K(0, 0); }
+    double fy() const { return K(1, 1); }
+    double cx() const { return K(0, 2); }
+    double cy() const { return K(1, 2); }
+
+    void backProject(const cv::Point2f* pixels, cv::Point2f* normalized, size_t count) const;     // Pixels to normalized image coordinates (ray directions)
+    void project(const cv::Point2f* normalized, cv::Point2f* pixels, size_t count) const;         // Normalized image coordinates to pixels
+
+    void backProject(const std::vector<cv::Point2f>& pixels, std::vector<cv::Point2f>& normalized) const;
+    void project(const std::vector<cv::Point2f>& normalized, std::vector<cv::Point2f>& pixels) const;
+
+private:
+    cv::Matx33d K;                  // Camera matrix, scaled so that K(2, 2) == 1
+    cv::Matx33d inverseK;
+
+    float projectCoefficients[5];       // fx, skew, cx, fy, cy as floats for the kernels
+    float backProjectCoefficients[5];   // The same terms of the inverse
+};
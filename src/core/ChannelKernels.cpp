@@ -0,0 +1,178 @@
+#include "ChannelKernels.hpp"
+#include "Parallel.hpp"
+
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <cmath>
+
+using namespace std;
+using namespace cv;
+
+#if CV_SIMD
+static inline void widen(const v_uint8& value, v_float32 out[4]) {     // 8-bit lanes to four float registers
+    v_uint16 half[2];
+    v_expand(value, half[0], half[1]);
+    for (int h = 0; h < 2; h++) {
+        v_uint32 quarter[2];
+        v_expand(half[h], quarter[0], quarter[1]);
+        out[2 * h] = v_cvt_f32(v_reinterpret_as_s32(quarter[0]));
+        out[2 * h + 1] = v_cvt_f32(v_reinterpret_as_s32(quarter[1]));
+    }
+}
+
+static inline v_uint8 narrow(const v_float32 in[4]) {                  // Round and saturate back to 8-bit lanes
+    return v_pack_u(v_pack(v_round(in[0]), v_round(in[1])), v_pack(v_round(in[2]), v_round(in[3])));
+}
+#endif
+
+template <typename RowKernel>
+static void forEachRowRange(int rows, RowKernel kernel) {               // Rows are independent
+    parallelForRanges(Range(0, rows), [&](const Range& range) {
+        for (int y = range.start; y < range.end; y++) {
+            kernel(y);
+        }
+    });
+}
+
+void maskChannel(Mat& bgr, int channel) {
+
+    CV_Assert(bgr.type() == CV_8UC3 && channel >= 0 && channel < 3);
+    Vec3f gains(1.0f, 1.0f, 1.0f);
+    gains[channel] = 0.0f;
+    scaleChannels(bgr, gains);
+}
+
+void scaleChannels(Mat& bgr, const Vec3f& gains) {
+
+    CV_Assert(bgr.type() == CV_8UC3);
+
+    bool maskOnly = true;                                               // Gains of 0 or 1: no arithmetic at all
+    for (int c = 0; c < 3; c++) {
+        maskOnly = maskOnly && (gains[c] == 0.0f || gains[c] == 1.0f);
+    }
+
+    int width = bgr.cols;
+    forEachRowRange(bgr.rows, [&](int y) {
+        uchar* row = bgr.ptr<uchar>(y);
+        int x = 0;
+
+#if CV_SIMD
+        const int lanes = v_uint8::nlanes;
+        if (maskOnly) {
+            v_uint8 zero = vx_setzero_u8();
+            for (; x <= width - lanes; x += lanes) {
+                v_uint8 channels[3];
+                v_load_deinterleave(row + 3 * x, channels[0], channels[1], channels[2]);
+                for (int c = 0; c < 3; c++) {
+                    if (gains[c] == 0.0f) {
+                        channels[c] = zero;
+                    }
+                }
+                v_store_interleave(row + 3 * x, channels[0], channels[1], channels[2]);
+            }
+        } else {
+            v_float32 gain[3] = {vx_setall_f32(gains[0]), vx_setall_f32(gains[1]), vx_setall_f32(gains[2])};
+            for (; x <= width - lanes; x += lanes) {
+                v_uint8 channels[3];
+                v_load_deinterleave(row + 3 * x, channels[0], channels[1], channels[2]);
+                for (int c = 0; c < 3; c++) {
+                    v_float32 wide[4];
+                    widen(channels[c], wide);
+                    for (int q = 0; q < 4; q++) {
+                        wide[q] = wide[q] * gain[c];
+                    }
+                    channels[c] = narrow(wide);
+                }
+                v_store_interleave(row + 3 * x, channels[0], channels[1], channels[2]);
+            }
+        }
+#endif
+
+        for (; x < width; x++) {
+            for (int c = 0; c < 3; c++) {
+                row[3 * x + c] = saturate_cast<uchar>(row[3 * x + c] * gains[c]);
+            }
+        }
+    });
+}
+
+void extractChannel(const Mat& bgr, Mat& destination, int channel) {
+
+    CV_Assert(bgr.type() == CV_8UC3 && channel >= 0 && channel < 3);
+    destination.create(bgr.size(), CV_8UC1);                           // No allocation when the size does not change
+
+    int width = bgr.cols;
+    forEachRowRange(bgr.rows, [&](int y) {
+        const uchar* source = bgr.ptr<uchar>(y);
+        uchar* out = destination.ptr<uchar>(y);
+        int x = 0;
+
+#if CV_SIMD
+        const int lanes = v_uint8::nlanes;
+        for (; x <= width - lanes; x += lanes) {
+            v_uint8 channels[3];
+            v_load_deinterleave(source + 3 * x, channels[0], channels[1], channels[2]);
+            v_store(out + x, channels[channel]);
+        }
+#endif
+
+        for (; x < width; x++) {
+            out[x] = source[3 * x + channel];
+        }
+    });
+}
+
+void weightedChannelMix(const Mat& bgr, Mat& destination, const Vec3f& weights, float offset) {
+
+    CV_Assert(bgr.type() == CV_8UC3);
+    destination.create(bgr.size(), CV_8UC1);
+
+    int width = bgr.cols;
+    forEachRowRange(bgr.rows, [&](int y) {
+        const uchar* source = bgr.ptr<uchar>(y);
+        uchar* out = destination.ptr<uchar>(y);
+        int x = 0;
+
+#if CV_SIMD
+        const int lanes = v_uint8::nlanes;
+        v_float32 wb = vx_setall_f32(weights[0]), wg = vx_setall_f32(weights[1]), wr = vx_setall_f32(weights[2]);
+        v_float32 bias = vx_setall_f32(offset);
+        for (; x <= width - lanes; x += lanes) {
+            v_uint8 b8, g8, r8;
+            v_load_deinterleave(source + 3 * x, b8, g8, r8);
+
+            v_float32 b[4], g[4], r[4], mixed[4];
+            widen(b8, b);
+            widen(g8, g);
+            widen(r8, r);
+            for (int q = 0; q < 4; q++) {
+                mixed[q] = v_fma(b[q], wb, v_fma(g[q], wg, v_fma(r[q], wr, bias)));
+            }
+            v_store(out + x, narrow(mixed));
+        }
+#endif
+
+        for (; x < width; x++) {
+            out[x] = saturate_cast<uchar>(weights[0] * source[3 * x] + weights[1] * source[3 * x + 1] + weights[2] * source[3 * x + 2] + offset);
+        }
+    });
+}
+
+Vec3f coneLikelihoodWeights(float hueDegrees) {
+
+    /*
+        Chroma plane of a BGR pixel: a = R - (G + B) / 2, b = sqrt(3) / 2 (G - B),
+        where red is at 0 degrees, yellow at 60 and blue at 240. Projecting
+        (a, b) on the direction of the hue gives a linear mix of B, G and R
+        whose weights sum to 0 (greys score nothing).
+    */
+
+    double angle = hueDegrees * CV_PI / 180.0;
+    double c = cos(angle), s = sin(angle), h = sqrt(3.0) / 2.0;
+    return Vec3f((float)(-0.5 * c - h * s), (float)(-0.5 * c + h * s), (float)c);
+}
+
+void coneLikelihood(const Mat& bgr, Mat& likelihood, float hueDegrees, float gain) {
+
+    weightedChannelMix(bgr, likelihood, coneLikelihoodWeights(hueDegrees) * gain);     // Other hues go negative and saturate to 0
+}
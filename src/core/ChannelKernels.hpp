@@ -0,0 +1,24 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+/*
+    Per-channel operations on interleaved 8-bit BGR images, without going
+    through split()/merge() or per-pixel at<>() calls. Every kernel
+    deinterleaves a register worth of pixels at a time with the OpenCV
+    universal intrinsics (SSE/AVX/NEON, whatever the build targets), works
+    in place where it can and splits the rows across cores.
+
+    The cone likelihood is a channel mix too: the chroma of a pixel is
+    projected on the direction of a hue, so grey pixels score 0 and pure
+    colors of that hue score their intensity, with no HSV conversion.
+*/
+
+void scaleChannels(cv::Mat& bgr, const cv::Vec3f& gains);                              // In place, saturated; 0/1 gains only move registers around
+void maskChannel(cv::Mat& bgr, int channel);                                            // In place, zero one channel
+
+void extractChannel(const cv::Mat& bgr, cv::Mat& destination, int channel);             // CV_8UC1 copy of one channel
+void weightedChannelMix(const cv::Mat& bgr, cv::Mat& destination, const cv::Vec3f& weights, float offset = 0.0f);   // CV_8UC1, saturated w.(B, G, R) + offset
+
+cv::Vec3f coneLikelihoodWeights(float hueDegrees);                                      // Mix weights projecting the chroma on a hue
+void coneLikelihood(const cv::Mat& bgr, cv::Mat& likelihood, float hueDegrees, float gain = 1.0f);   // CV_8UC1, how much of that hue every pixel has
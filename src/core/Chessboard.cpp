@@ -0,0 +1,37 @@
+#include "Chessboard.hpp"
+#include "Trace.hpp"
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+
+using namespace std;
+using namespace cv;
+
+void createKnownBoardPosition(Size boardSize, float squareEdgeLength, vector<Point3f>& corners) {
+
+    for (int i = 0; i < boardSize.height; i++) {
+        for (int j = 0; j < boardSize.width; j++) {
+            corners.push_back(Point3f(j * squareEdgeLength, i * squareEdgeLength, 0.0f));
+        }
+    }
+}
+
+bool findCalibrationCorners(const Mat& image, Size boardSize, vector<Point2f>& corners) {
+
+    TRACE_SCOPE("findCalibrationCorners");
+
+    Mat gray;                                                                                   // Corner search and refinement both work on the grey image
+    if (image.channels() == 1) {
+        gray = image;
+    } else {
+        cvtColor(image, gray, COLOR_BGR2GRAY);
+    }
+
+    bool found = findChessboardCorners(gray, boardSize, corners, CALIB_CB_ADAPTIVE_THRESH | CALIB_CB_NORMALIZE_IMAGE | CALIB_CB_FAST_CHECK);  // Execute findChessboardCorners (built into OpenCV), the fast check rejects images without a board early
+
+    if (found) {
+        cornerSubPix(gray, corners, Size(5, 5), Size(-1, -1), TermCriteria(TermCriteria::EPS + TermCriteria::COUNT, 30, 0.01));     // Refine the corners to sub-pixel accuracy
+    }
+
+    return found;
+}
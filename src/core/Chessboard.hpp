@@ -0,0 +1,12 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+const cv::Size chessboardDimensions = cv::Size(4, 8);       // Number of square on Chessboard calibration page
+const float calibrationSquareDimension = 0.03f;             // Dimension of side of one square [m]
+
+void createKnownBoardPosition(cv::Size boardSize, float squareEdgeLength, std::vector<cv::Point3f>& corners);   // 3D position of the chessboard corners on the calibration page
+
+bool findCalibrationCorners(const cv::Mat& image, cv::Size boardSize, std::vector<cv::Point2f>& corners);       // Find the chessboard corners in one calibration image, refined to sub-pixel accuracy
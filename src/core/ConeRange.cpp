@@ -0,0 +1,72 @@
+#include "ConeRange.hpp"
+#include "Trace.hpp"
+
+#include <cmath>
+
+using namespace std;
+using namespace cv;
+
+GroundPlane::GroundPlane() : down(0, 1, 0), forward(0, 0, 1), right(1, 0, 0), height(0.0) {}
+
+GroundPlane::GroundPlane(double cameraHeight, double pitch, double roll) : height(cameraHeight) {
+
+    down = Vec3d(sin(roll) * cos(pitch), cos(roll) * cos(pitch), sin(pitch));    // Image y axis of a level camera, pitched then rolled with the camera
+
+    Vec3d opticalAxis(0, 0, 1);
+    forward = normalize(opticalAxis - opticalAxis.dot(down) * down);            // Optical axis, flattened onto the ground
+    right = down.cross(forward);                                                 // x = y cross z
+}
+
+ConeRangeEstimator::ConeRangeEstimator(const CameraIntrinsics& intrinsics, const Mat& distortionCoefficients, const GroundPlane& ground)
+    : intrinsics(intrinsics), distortionCoefficients(distortionCoefficients), ground(ground) {
+
+    geometries[CONE_BLUE - 1] = smallConeGeometry;
+    geometries[CONE_YELLOW - 1] = smallConeGeometry;
+    geometries[CONE_ORANGE - 1] = smallConeGeometry;                            // setGeometry(CONE_ORANGE, largeConeGeometry) near the start line
+}
+
+void ConeRangeEstimator::estimate(const vector<ConeBlob>& blobs, Size imageSize, vector<ConeRange>& ranges) {
+
+    TRACE_SCOPE("estimateConeRanges");
+
+    if (undistorter.empty() || undistorter.imageSize() != imageSize) {          // Build the lookup on the first frame (or if the resolution changes)
+        undistorter.create(Mat(intrinsics.matrix()), distortionCoefficients, imageSize);
+    }
+
+    distortedPoints.resize(2 * blobs.size());                                   // Top and bottom center of every box, undistorted in one pass
+    for (size_t i = 0; i < blobs.size(); i++) {
+        const Rect& box = blobs[i].boundingBox;
+        float centerX = box.x + 0.5f * box.width;
+        distortedPoints[2 * i] = Point2f(centerX, (float)box.y);
+        distortedPoints[2 * i + 1] = Point2f(centerX, (float)(box.y + box.height));
+    }
+    undistorter.undistort(distortedPoints, undistortedPoints);
+    intrinsics.backProject(undistortedPoints, normalizedPoints);               // Ray directions
+
+    ranges.resize(blobs.size());
+    for (size_t i = 0; i < blobs.size(); i++) {
+        const Point2f& top = normalizedPoints[2 * i];
+        const Point2f& bottom = normalizedPoints[2 * i + 1];
+        Vec3d ray(bottom.x, bottom.y, 1.0);                                     // Through the center of the cone base
+
+        ConeRange& cone = ranges[i];
+        cone.coneClass = blobs[i].coneClass;
+
+        double towardsGround = ray.dot(ground.down);
+        double depth;
+        if (ground.known() && towardsGround > 1e-3) {                           // The ray meets the ground in front of the camera
+            depth = ground.height / towardsGround;
+            cone.onGround = true;
+        } else {
+            double span = bottom.y - top.y;                                     // Apparent height, in normalized coordinates
+            depth = span > 1e-6 ? geometries[cone.coneClass - 1].height / span : 0.0;
+            cone.onGround = false;
+        }
+
+        Vec3d position = ray * depth;
+        double ahead = position.dot(ground.forward), aside = position.dot(ground.right);
+        cone.position = Point3f((float)position[0], (float)position[1], (float)position[2]);
+        cone.range = (float)sqrt(ahead * ahead + aside * aside);
+        cone.bearing = (float)atan2(aside, ahead);
+    }
+}
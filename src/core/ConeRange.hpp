@@ -0,0 +1,76 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+#include "CameraIntrinsics.hpp"
+#include "ConeSegmentation.hpp"
+#include "MarkerPose.hpp"
+
+/*
+    Range and bearing of every cone blob of a frame, from one camera. The
+    top and bottom centers of all the bounding boxes are undistorted through
+    the cached lookup and back-projected in one batch. Each cone then takes
+    a few closed-form operations, without any iterative solve:
+
+        apparent height   the cone stands upright, so its known height H
+                          spans (yBottom - yTop) in normalized image
+                          coordinates: depth = H / (yBottom - yTop)
+
+        ground plane      when the mounting of the camera is known, the ray
+                          through the bottom center of the box is cut with
+                          the ground plane: depth does not depend on the
+                          box height at all (partly hidden cones, blurred
+                          tops), only on where the cone touches the ground
+
+    Range and bearing are measured in the horizontal plane: along the ground
+    when the camera mounting is known, otherwise assuming a level camera.
+    Cone sizes are those of the Formula Student rules.
+*/
+
+struct ConeGeometry {
+    float height;                   // [m]
+};
+
+const ConeGeometry smallConeGeometry = {0.325f};            // Blue, yellow and small orange cones
+const ConeGeometry largeConeGeometry = {0.505f};            // Big orange cones at the start and finish
+
+struct ConeRange {                  // Where one cone blob is
+    ConeClass coneClass;
+    cv::Point3f position;           // Center of the cone base, in the camera frame (x right, y down, z forward) [m]
+    float range;                    // Horizontal distance from the camera [m]
+    float bearing;                  // Horizontal angle from straight ahead, positive to the right [rad]
+    bool onGround;                  // Found with the ground plane (otherwise from the apparent height)
+};
+
+class GroundPlane {                 // Flat ground under the camera, in the camera frame
+public:
+    GroundPlane();                                                  // Level camera, unknown height: apparent height only
+    GroundPlane(double cameraHeight, double pitch, double roll = 0.0);     // Camera this high above the ground [m], tilted down by pitch and rolled right by roll [rad]
+
+    bool known() const { return height > 0.0; }
+
+    cv::Vec3d down;                 // Unit vector pointing at the ground
+    cv::Vec3d forward, right;       // Horizontal unit vectors, straight ahead of the camera and to its right
+    double height;                  // Distance from the camera to the ground [m], 0 if unknown
+};
+
+class ConeRangeEstimator {
+public:
+    ConeRangeEstimator(const CameraIntrinsics& intrinsics, const cv::Mat& distortionCoefficients, const GroundPlane& ground = GroundPlane());
+
+    void useUndistorter(const CornerUndistorter& precomputed) { undistorter = precomputed; }   // Skip building the lookup on the first frame
+
+    void setGeometry(ConeClass coneClass, const ConeGeometry& geometry) { geometries[coneClass - 1] = geometry; }
+
+    void estimate(const std::vector<ConeBlob>& blobs, cv::Size imageSize, std::vector<ConeRange>& ranges);   // One range per blob, in the same order
+
+private:
+    CameraIntrinsics intrinsics;
+    cv::Mat distortionCoefficients;
+    GroundPlane ground;
+    ConeGeometry geometries[coneClassCount];
+    CornerUndistorter undistorter;
+    std::vector<cv::Point2f> distortedPoints, undistortedPoints, normalizedPoints;     // Top and bottom center of every box, kept from frame to frame
+};
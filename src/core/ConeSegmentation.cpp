@@ -0,0 +1,166 @@
+#include "ConeSegmentation.hpp"
+#include "Parallel.hpp"
+#include "Trace.hpp"
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <algorithm>
+
+using namespace std;
+using namespace cv;
+
+ConeSegmenter::ConeSegmenter() {
+
+    ranges[CONE_BLUE - 1] = {190.0f, 250.0f, 0.45f, 40.0f};            // Blue cones are fairly dark in the shade
+    ranges[CONE_YELLOW - 1] = {40.0f, 65.0f, 0.50f, 80.0f};
+    ranges[CONE_ORANGE - 1] = {-10.0f, 25.0f, 0.55f, 60.0f};
+}
+
+void ConeSegmenter::setRange(ConeClass coneClass, const ConeColorRange& range) {
+
+    CV_Assert(coneClass >= CONE_BLUE && coneClass <= CONE_ORANGE);
+    ranges[coneClass - 1] = range;
+}
+
+static inline uchar classifyPixel(float b, float g, float r, const ConeColorRange* ranges) {   // Scalar version of the kernel, for the end of the rows
+
+    float mx = max(b, max(g, r));
+    float mn = min(b, min(g, r));
+    float d = mx - mn;
+
+    if (d <= 0.0f) {                                                    // Grey pixel, no hue
+        return CONE_NONE;
+    }
+
+    float n = (mx == r) ? g - b : (mx == g) ? b - r + 2.0f * d : r - g + 4.0f * d;
+    float h60 = 60.0f * n;                                              // hue * delta
+
+    for (int k = 0; k < coneClassCount; k++) {
+        const ConeColorRange& range = ranges[k];
+        if (h60 >= range.hueMin * d && h60 <= range.hueMax * d && d >= range.saturationMin * mx && mx >= range.valueMin) {
+            return (uchar)(k + 1);
+        }
+    }
+    return CONE_NONE;
+}
+
+#if CV_SIMD
+struct SimdRanges {                                                     // Thresholds broadcast once per call
+    v_float32 hueMin[coneClassCount], hueMax[coneClassCount], saturationMin[coneClassCount], valueMin[coneClassCount], label[coneClassCount];
+};
+
+static inline v_int32 classifyLanes(const v_float32& b, const v_float32& g, const v_float32& r, const SimdRanges& simd) {
+
+    v_float32 zero = vx_setzero_f32();
+    v_float32 mx = v_max(b, v_max(g, r));
+    v_float32 mn = v_min(b, v_min(g, r));
+    v_float32 d = mx - mn;
+
+    v_float32 maxIsR = mx == r;
+    v_float32 maxIsG = (mx == g) & (mx != r);
+    v_float32 n = v_select(maxIsR, g - b, v_select(maxIsG, b - r + d + d, r - g + d * vx_setall_f32(4.0f)));
+    v_float32 h60 = n * vx_setall_f32(60.0f);
+    v_float32 colored = d > zero;
+
+    v_float32 label = zero;
+    for (int k = coneClassCount - 1; k >= 0; k--) {                    // Backwards so that the first matching class wins, as in the scalar version
+        v_float32 inRange = colored & (h60 >= simd.hueMin[k] * d) & (h60 <= simd.hueMax[k] * d)
+                          & (d >= simd.saturationMin[k] * mx) & (mx >= simd.valueMin[k]);
+        label = v_select(inRange, simd.label[k], label);
+    }
+    return v_round(label);
+}
+#endif
+
+static void classifyRows(const Mat& bgr, Mat& mask, const ConeColorRange* ranges, int rowStart, int rowEnd) {
+
+    int width = bgr.cols;
+
+#if CV_SIMD
+    SimdRanges simd;
+    for (int k = 0; k < coneClassCount; k++) {
+        simd.hueMin[k] = vx_setall_f32(ranges[k].hueMin);
+        simd.hueMax[k] = vx_setall_f32(ranges[k].hueMax);
+        simd.saturationMin[k] = vx_setall_f32(ranges[k].saturationMin);
+        simd.valueMin[k] = vx_setall_f32(ranges[k].valueMin);
+        simd.label[k] = vx_setall_f32((float)(k + 1));
+    }
+    const int lanes = v_uint8::nlanes;
+#endif
+
+    for (int y = rowStart; y < rowEnd; y++) {
+        const uchar* source = bgr.ptr<uchar>(y);
+        uchar* destination = mask.ptr<uchar>(y);
+        int x = 0;
+
+#if CV_SIMD
+        for (; x <= width - lanes; x += lanes) {
+            v_uint8 b8, g8, r8;
+            v_load_deinterleave(source + 3 * x, b8, g8, r8);           // Split the interleaved BGR pixels into three registers
+
+            v_uint16 b16[2], g16[2], r16[2];
+            v_expand(b8, b16[0], b16[1]);
+            v_expand(g8, g16[0], g16[1]);
+            v_expand(r8, r16[0], r16[1]);
+
+            v_int32 labels[4];
+            for (int half = 0; half < 2; half++) {                      // Widen to float, a quarter of the register at a time
+                v_uint32 b32[2], g32[2], r32[2];
+                v_expand(b16[half], b32[0], b32[1]);
+                v_expand(g16[half], g32[0], g32[1]);
+                v_expand(r16[half], r32[0], r32[1]);
+
+                for (int q = 0; q < 2; q++) {
+                    labels[2 * half + q] = classifyLanes(v_cvt_f32(v_reinterpret_as_s32(b32[q])),
+                                                         v_cvt_f32(v_reinterpret_as_s32(g32[q])),
+                                                         v_cvt_f32(v_reinterpret_as_s32(r32[q])), simd);
+                }
+            }
+
+            v_store(destination + x, v_pack_u(v_pack(labels[0], labels[1]), v_pack(labels[2], labels[3])));    // Narrow the labels back to one byte per pixel
+        }
+#endif
+
+        for (; x < width; x++) {
+            destination[x] = classifyPixel(source[3 * x], source[3 * x + 1], source[3 * x + 2], ranges);
+        }
+    }
+}
+
+void ConeSegmenter::classify(const Mat& bgr, Mat& mask) const {
+
+    CV_Assert(bgr.type() == CV_8UC3);
+    mask.create(bgr.size(), CV_8UC1);                                   // No allocation when the size does not change
+
+    parallelForRanges(Range(0, bgr.rows), [&](const Range& rows) {      // Rows are independent
+        classifyRows(bgr, mask, ranges, rows.start, rows.end);
+    });
+}
+
+void ConeSegmenter::segment(const Mat& bgr, vector<ConeBlob>& blobs) {
+
+    TRACE_SCOPE("segmentCones");
+
+    classify(bgr, classMask);
+    blobs.clear();
+
+    for (int k = 0; k < coneClassCount; k++) {
+        compare(classMask, k + 1, binary[k], CMP_EQ);
+        int nLabels = connectedComponentsWithStats(binary[k], labels[k], stats[k], centroids[k], 8, CV_32S);
+
+        for (int label = 1; label < nLabels; label++) {                // Label 0 is the background
+            const int* stat = stats[k].ptr<int>(label);
+            if (stat[CC_STAT_AREA] < minimumArea) {
+                continue;
+            }
+
+            ConeBlob blob;
+            blob.coneClass = (ConeClass)(k + 1);
+            blob.boundingBox = Rect(stat[CC_STAT_LEFT], stat[CC_STAT_TOP], stat[CC_STAT_WIDTH], stat[CC_STAT_HEIGHT]);
+            blob.area = stat[CC_STAT_AREA];
+            blob.centroid = Point2f((float)centroids[k].at<double>(label, 0), (float)centroids[k].at<double>(label, 1));
+            blobs.push_back(blob);
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+/*
+    Cone color segmentation. Every BGR pixel is classified as blue, yellow or
+    orange cone (or background) in a single fused pass: hue, saturation and
+    value are never stored, the thresholds are evaluated directly on the BGR
+    values with SIMD and the result is a one byte class label per pixel. Rows
+    are split across cores.
+
+    Hue thresholds avoid the division of the usual HSV conversion: with
+    delta = max - min, the hue of a pixel (in degrees) is 60 * n / delta
+    where n is linear in B, G, R, so hueMin <= hue <= hueMax is tested as
+    hueMin * delta <= 60 * n <= hueMax * delta. Hues are expressed on the
+    interval (-60, 300], reds just below zero therefore stay contiguous
+    with oranges.
+*/
+
+enum ConeClass {
+    CONE_NONE = 0,
+    CONE_BLUE = 1,
+    CONE_YELLOW = 2,
+    CONE_ORANGE = 3
+};
+
+const int coneClassCount = 3;
+
+struct ConeColorRange {                 // Which pixels belong to one cone color
+    float hueMin;                       // [deg], on (-60, 300]
+    float hueMax;
+    float saturationMin;                // (max - min) / max, in [0, 1]
+    float valueMin;                     // max(B, G, R), in [0, 255]
+};
+
+struct ConeBlob {                       // One connected region of a single cone color
+    ConeClass coneClass;
+    cv::Rect boundingBox;
+    int area;                           // [px]
+    cv::Point2f centroid;
+};
+
+class ConeSegmenter {
+public:
+    ConeSegmenter();                                        // Default ranges for Formula Student cones
+
+    void setRange(ConeClass coneClass, const ConeColorRange& range);
+    const ConeColorRange& range(ConeClass coneClass) const { return ranges[coneClass - 1]; }
+
+    void classify(const cv::Mat& bgr, cv::Mat& mask) const;                 // CV_8UC1 mask of ConeClass labels
+    void segment(const cv::Mat& bgr, std::vector<ConeBlob>& blobs);         // Classify, then extract the blobs of every color
+
+    const cv::Mat& mask() const { return classMask; }      // Labels of the last frame passed to segment()
+
+    int minimumArea = 30;                                   // Smaller blobs are dropped [px]
+
+private:
+    ConeColorRange ranges[coneClassCount];
+
+    cv::Mat classMask;                                      // Buffers kept from frame to frame
+    cv::Mat binary[coneClassCount], labels[coneClassCount], stats[coneClassCount], centroids[coneClassCount];
+};
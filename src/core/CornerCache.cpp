@@ -0,0 +1,117 @@
+#include "CornerCache.hpp"
+
+#include <fstream>
+#include <iomanip>
+
+using namespace std;
+using namespace cv;
+
+static const char* cacheHeader = "3DVisCornerCache";
+static const int cacheVersion = 1;
+
+uint64_t hashFile(const string& path) {
+
+    ifstream inStream(path, ios::binary);
+    if (!inStream) {
+        return 0;
+    }
+
+    uint64_t hash = 14695981039346656037ULL;                            // FNV-1a offset basis
+    char buffer[1 << 16];
+
+    while (inStream) {
+        inStream.read(buffer, sizeof(buffer));
+        streamsize n = inStream.gcount();
+        for (streamsize i = 0; i < n; i++) {
+            hash ^= (unsigned char)buffer[i];
+            hash *= 1099511628211ULL;                                   // FNV prime
+        }
+    }
+
+    return hash;
+}
+
+bool CornerCache::load(const string& name, Size boardSize) {
+
+    entries.clear();
+
+    ifstream inStream(name);
+    if (!inStream) {
+        return false;
+    }
+
+    string header;
+    int version = 0;
+    Size cachedBoard;
+    inStream >> header >> version >> cachedBoard.width >> cachedBoard.height;
+
+    if (header != cacheHeader || version != cacheVersion || cachedBoard != boardSize) {    // Results for another board (or another format) are useless
+        return false;
+    }
+
+    uint64_t fileHash;
+    while (inStream >> hex >> fileHash >> dec) {                        // One line per image: hash found width height nCorners x y x y ...
+        Entry entry;
+        int found = 0;
+        size_t nCorners = 0;
+        inStream >> found >> entry.imageSize.width >> entry.imageSize.height >> nCorners;
+        entry.found = found != 0;
+
+        entry.corners.resize(nCorners);
+        for (size_t i = 0; i < nCorners; i++) {
+            inStream >> entry.corners[i].x >> entry.corners[i].y;
+        }
+
+        if (!inStream) {                                                // Truncated file, drop the partial entry
+            break;
+        }
+        entries[fileHash] = entry;
+    }
+
+    return true;
+}
+
+bool CornerCache::save(const string& name, Size boardSize) const {
+
+    ofstream outStream(name);
+    if (!outStream) {
+        return false;
+    }
+
+    outStream << cacheHeader << " " << cacheVersion << endl;
+    outStream << boardSize.width << " " << boardSize.height << endl;
+    outStream << setprecision(9);                                       // Enough digits to round-trip a float
+
+    for (const auto& item : entries) {
+        const Entry& entry = item.second;
+        outStream << hex << item.first << dec << " " << (entry.found ? 1 : 0) << " " << entry.imageSize.width << " " << entry.imageSize.height << " " << entry.corners.size();
+        for (const Point2f& corner : entry.corners) {
+            outStream << " " << corner.x << " " << corner.y;
+        }
+        outStream << endl;
+    }
+
+    return (bool)outStream;                                             // A full disk leaves a truncated cache
+}
+
+bool CornerCache::lookup(uint64_t fileHash, ChessboardView& view) const {
+
+    auto item = entries.find(fileHash);
+    if (item == entries.end()) {
+        return false;
+    }
+
+    view.found = item->second.found;
+    view.imageSize = item->second.imageSize;
+    view.corners = item->second.corners;
+    return true;
+}
+
+void CornerCache::store(const ChessboardView& view) {
+
+    Entry entry;
+    entry.found = view.found;
+    entry.imageSize = view.imageSize;
+    entry.corners = view.corners;
+    entries[view.fileHash] = entry;
+}
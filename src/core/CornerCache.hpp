@@ -0,0 +1,45 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+    On-disk cache of chessboard corner search results, keyed by a hash of
+    the image file contents. Re-running the calibration after adding a few
+    images only searches the new ones; renaming or moving images does not
+    invalidate anything, editing them does.
+*/
+
+struct ChessboardView {                             // Corner search result for one calibration image
+    std::string path;
+    uint64_t fileHash = 0;
+    bool found = false;
+    cv::Size imageSize;
+    std::vector<cv::Point2f> corners;
+};
+
+uint64_t hashFile(const std::string& path);         // 64-bit FNV-1a hash of the file contents (0 if it cannot be read)
+
+class CornerCache {
+public:
+    bool load(const std::string& name, cv::Size boardSize);        // Returns false (and stays empty) if missing or made for another board
+    bool save(const std::string& name, cv::Size boardSize) const;
+
+    bool lookup(uint64_t fileHash, ChessboardView& view) const;    // Read-only, safe to call from several threads at once
+    void store(const ChessboardView& view);
+
+    size_t size() const { return entries.size(); }
+
+private:
+    struct Entry {
+        bool found;
+        cv::Size imageSize;
+        std::vector<cv::Point2f> corners;
+    };
+
+    std::unordered_map<uint64_t, Entry> entries;
+};
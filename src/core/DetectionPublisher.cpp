@@ -0,0 +1,143 @@
+#include "DetectionPublisher.hpp"
+#include "FrameSource.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace cv;
+
+static_assert(sizeof(StreamMarker) == sizeof(SessionMarker), "a published marker has the layout of a recorded one");
+
+bool DetectionPublisher::open(const string& name, uint32_t slotCount) {
+
+    close();
+    lastError.clear();
+
+    CV_Assert(slotCount > 0);
+    shm_unlink(name.c_str());                                                           // Subscribers of a previous run keep their old mapping, new ones get this stream
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        lastError = "cannot create the detection stream " + name;
+        return false;
+    }
+
+    size = sizeof(DetectionStreamHeader) + slotCount * sizeof(DetectionStreamSlot);
+    void* mapped = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {                                                     // New shared memory reads as zeros: no slot written yet
+        mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+
+    if (mapped == MAP_FAILED) {
+        lastError = "cannot map the detection stream " + name;
+        shm_unlink(name.c_str());
+        size = 0;
+        return false;
+    }
+
+    header = (DetectionStreamHeader*)mapped;
+    slots = (DetectionStreamSlot*)(header + 1);
+    streamName = name;
+
+    header->version = detectionStreamVersion;
+    header->slotCount = slotCount;
+    header->slotBytes = sizeof(DetectionStreamSlot);
+    header->published.store(0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, detectionStreamMagic, sizeof(header->magic));                // Last, a subscriber that sees the magic sees the rest
+    return true;
+}
+
+void DetectionPublisher::close() {
+
+    if (header != nullptr) {
+        munmap(header, size);
+        shm_unlink(streamName.c_str());
+    }
+    header = nullptr;
+    slots = nullptr;
+    size = 0;
+}
+
+void DetectionPublisher::publish(int frameIndex, double timestampMilliseconds, const vector<int>& markerIDs, const vector<vector<Point2f>>& markerCorners,
+                                 const vector<Vec3d>& rotationVectors, const vector<Vec3d>& translationVectors, const vector<ConeBlob>& cones,
+                                 const vector<TrackedObject>& tracks) {
+
+    if (header == nullptr) {
+        return;
+    }
+
+    uint64_t number = header->published.load(memory_order_relaxed);                   // Only this thread writes it
+    DetectionStreamSlot& slot = slots[number % header->slotCount];
+
+    slot.sequence.store(2 * number + 1, memory_order_relaxed);                         // Odd: readers of the frame this slot held give up
+    atomic_thread_fence(memory_order_release);                                         // Before any byte of the record changes
+
+    StreamFrame& frame = slot.frame;
+    frame.frameIndex = frameIndex;
+    frame.timestampMilliseconds = timestampMilliseconds;
+
+    frame.markerCount = (int32_t)min(markerIDs.size(), (size_t)streamMaxMarkers);
+    for (int i = 0; i < frame.markerCount; i++) {
+        StreamMarker& marker = frame.markers[i];
+        marker.id = markerIDs[i];
+
+        for (size_t c = 0; c < 4; c++) {
+            bool known = (size_t)i < markerCorners.size() && c < markerCorners[i].size();
+            marker.corners[2 * c] = known ? markerCorners[i][c].x : 0.0f;
+            marker.corners[2 * c + 1] = known ? markerCorners[i][c].y : 0.0f;
+        }
+
+        marker.hasPose = (size_t)i < rotationVectors.size() && (size_t)i < translationVectors.size();
+        for (int k = 0; k < 3; k++) {
+            marker.rotation[k] = marker.hasPose ? rotationVectors[i][k] : 0.0;
+            marker.translation[k] = marker.hasPose ? translationVectors[i][k] : 0.0;
+        }
+    }
+
+    frame.coneCount = (int32_t)min(cones.size(), (size_t)streamMaxCones);
+    for (int i = 0; i < frame.coneCount; i++) {
+        const ConeBlob& blob = cones[i];
+        StreamCone& cone = frame.cones[i];
+        cone.coneClass = blob.coneClass;
+        cone.area = blob.area;
+        cone.x = blob.boundingBox.x;
+        cone.y = blob.boundingBox.y;
+        cone.width = blob.boundingBox.width;
+        cone.height = blob.boundingBox.height;
+        cone.centroidX = blob.centroid.x;
+        cone.centroidY = blob.centroid.y;
+    }
+
+    frame.trackCount = 0;
+    for (size_t i = 0; i < tracks.size() && frame.trackCount < streamMaxTracks; i++) {
+        const TrackedObject& object = tracks[i];
+        if (!object.confirmed) {                                                        // Tentative tracks are mostly noise
+            continue;
+        }
+        StreamTrack& track = frame.tracks[frame.trackCount++];
+        track.trackId = object.trackId;
+        track.label = object.label;
+        track.position[0] = object.position.x;
+        track.position[1] = object.position.y;
+        track.position[2] = object.position.z;
+        track.velocity[0] = object.velocity.x;
+        track.velocity[1] = object.velocity.y;
+        track.velocity[2] = object.velocity.z;
+        track.age = object.age;
+        track.missed = object.missed;
+        track.confidence = object.confidence;
+        track.reserved = 0;
+    }
+
+    frame.publishMilliseconds = steadyMilliseconds();
+    slot.sequence.store(2 * (number + 1), memory_order_release);                       // Complete
+    header->published.store(number + 1, memory_order_release);
+}
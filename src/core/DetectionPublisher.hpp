@@ -0,0 +1,43 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <string>
+#include <vector>
+
+#include "ConeSegmentation.hpp"
+#include "DetectionStream.hpp"
+#include "ObjectTracker.hpp"
+
+/*
+    Writing side of the detection stream (see DetectionStream.hpp). One
+    thread publishes; the shared memory is created when the publisher opens
+    and removed when it closes, so subscribers have to open the stream again
+    after the publisher restarts.
+*/
+
+class DetectionPublisher {
+public:
+    DetectionPublisher() {}
+    ~DetectionPublisher() { close(); }
+
+    DetectionPublisher(const DetectionPublisher&) = delete;
+    DetectionPublisher& operator=(const DetectionPublisher&) = delete;
+
+    bool open(const std::string& name = defaultDetectionStream, uint32_t slotCount = 64);  // Replaces a stream left behind by a previous run
+    void close();
+
+    bool isOpen() const { return header != nullptr; }
+    const std::string& error() const { return lastError; }
+
+    void publish(int frameIndex, double timestampMilliseconds, const std::vector<int>& markerIDs, const std::vector<std::vector<cv::Point2f>>& markerCorners,
+                 const std::vector<cv::Vec3d>& rotationVectors, const std::vector<cv::Vec3d>& translationVectors, const std::vector<ConeBlob>& cones,
+                 const std::vector<TrackedObject>& tracks = std::vector<TrackedObject>());     // Only the confirmed tracks are published
+
+private:
+    DetectionStreamHeader* header = nullptr;
+    DetectionStreamSlot* slots = nullptr;
+    size_t size = 0;
+    std::string streamName;
+    std::string lastError;
+};
@@ -0,0 +1,121 @@
+#include "DetectionStream.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+bool DetectionSubscriber::open(const string& name) {
+
+    close();
+    lastError.clear();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        lastError = "no detection stream " + name + " (is the publisher running?)";
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(DetectionStreamHeader)) {
+        ::close(fd);
+        lastError = name + " is too small to be a detection stream";
+        return false;
+    }
+
+    size = (size_t)info.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);                                                                        // The mapping stays valid without the descriptor
+
+    if (mapped == MAP_FAILED) {
+        lastError = "cannot map " + name;
+        size = 0;
+        return false;
+    }
+    header = (const DetectionStreamHeader*)mapped;
+    slots = (const DetectionStreamSlot*)(header + 1);
+
+    if (memcmp(header->magic, detectionStreamMagic, sizeof(detectionStreamMagic)) != 0) {
+        lastError = name + " is not a detection stream";
+    } else if (header->version != detectionStreamVersion || header->slotBytes != sizeof(DetectionStreamSlot)) {
+        lastError = name + " has version " + to_string(header->version) + ", expected " + to_string(detectionStreamVersion);
+    } else if (header->slotCount == 0 || size < sizeof(DetectionStreamHeader) + header->slotCount * sizeof(DetectionStreamSlot)) {
+        lastError = name + " is truncated";
+    }
+
+    if (!lastError.empty()) {
+        close();
+        return false;
+    }
+
+    cursor = published();
+    droppedFrames = 0;
+    return true;
+}
+
+void DetectionSubscriber::close() {
+
+    if (header != nullptr) {
+        munmap((void*)header, size);
+    }
+    header = nullptr;
+    slots = nullptr;
+    size = 0;
+}
+
+bool DetectionSubscriber::read(uint64_t number, StreamFrame& frame) const {
+
+    const DetectionStreamSlot& slot = slots[number % header->slotCount];
+    uint64_t complete = 2 * (number + 1);
+
+    if (slot.sequence.load(memory_order_acquire) != complete) {                        // Being rewritten, or already holding a newer frame
+        return false;
+    }
+
+    const StreamFrame& shared = slot.frame;
+    frame.frameIndex = shared.frameIndex;
+    frame.timestampMilliseconds = shared.timestampMilliseconds;
+    frame.publishMilliseconds = shared.publishMilliseconds;
+    frame.markerCount = min(max(shared.markerCount, 0), streamMaxMarkers);             // Counts are checked before they are trusted, the copy may be torn
+    frame.coneCount = min(max(shared.coneCount, 0), streamMaxCones);
+    frame.trackCount = min(max(shared.trackCount, 0), streamMaxTracks);
+    memcpy(frame.markers, shared.markers, frame.markerCount * sizeof(StreamMarker));   // Only the used part of the slot
+    memcpy(frame.cones, shared.cones, frame.coneCount * sizeof(StreamCone));
+    memcpy(frame.tracks, shared.tracks, frame.trackCount * sizeof(StreamTrack));
+
+    atomic_thread_fence(memory_order_acquire);                                         // The copy happens before the second check
+    return slot.sequence.load(memory_order_relaxed) == complete;
+}
+
+bool DetectionSubscriber::next(StreamFrame& frame) {
+
+    for (uint64_t newest = published(); cursor < newest; newest = published()) {
+        if (newest - cursor > header->slotCount) {                                      // Lapped by the publisher: those frames are gone
+            droppedFrames += newest - header->slotCount - cursor;
+            cursor = newest - header->slotCount;
+        }
+
+        if (read(cursor++, frame)) {
+            return true;
+        }
+        droppedFrames++;                                                                // Overwritten while we were copying it
+    }
+    return false;
+}
+
+bool DetectionSubscriber::latest(StreamFrame& frame) {
+
+    for (uint64_t newest = published(); cursor < newest; newest = published()) {
+        cursor = newest;                                                                // Older frames are skipped on purpose, they do not count as dropped
+
+        if (read(newest - 1, frame)) {                                                  // Overwritten during the copy: a newer one is there, try again
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*
+    Detection results shared with other processes on the same machine. The
+    tool that detects publishes one record per frame (markers with their
+    corners and pose, cone blobs, object tracks) into a ring of fixed size slots in POSIX
+    shared memory; any number of readers map the same memory and copy the
+    records out. There is no socket, no serialization and no lock: a reader
+    sees a frame about a microsecond after it was published.
+
+    Every slot is a seqlock. The publisher makes the sequence of the slot
+    odd, writes the record, then sets the sequence to 2 * (frame number + 1);
+    a reader copies the record and keeps it only if the sequence was that
+    value before and after the copy. The publisher never waits for the
+    readers: a reader that falls more than a ring behind skips the frames
+    that were overwritten, and counts them.
+
+    This header only depends on the standard library, so that a consumer
+    can link 3dvis_stream without OpenCV. Timestamps are on the steady
+    clock (CLOCK_MONOTONIC), which all the processes of the machine share.
+
+    Shared memory layout (native byte order):
+
+        DetectionStreamHeader
+        DetectionStreamSlot[slotCount]
+*/
+
+const char detectionStreamMagic[8] = {'3', 'D', 'V', 'I', 'S', 'S', 'H', 'M'};
+const uint32_t detectionStreamVersion = 2;     // 2: object tracks
+const char defaultDetectionStream[] = "/3dvis-detections";  // Name given to shm_open
+
+const int streamMaxMarkers = 50;            // Every marker of the 4x4_50 dictionary
+const int streamMaxCones = 64;              // Blobs past this many are not published
+const int streamMaxTracks = 64;             // Confirmed tracks past this many are not published
+
+struct StreamMarker {                       // Same layout as SessionMarker
+    int32_t id;
+    int32_t hasPose;
+    float corners[8];                       // x, y of the four corners [px]
+    double rotation[3];                     // Rodrigues vector
+    double translation[3];                  // [m], in the camera frame
+};
+
+struct StreamCone {
+    int32_t coneClass;                      // ConeClass: 1 blue, 2 yellow, 3 orange
+    int32_t area;                           // [px]
+    int32_t x, y, width, height;            // Bounding box [px]
+    float centroidX, centroidY;
+};
+
+struct StreamTrack {                        // Object followed across frames (see ObjectTracker.hpp)
+    int32_t trackId;                        // Stable from frame to frame
+    int32_t label;                          // Cone class or marker ID
+    float position[3];                      // Kalman filtered [m], in the camera frame
+    float velocity[3];                      // [m/s]
+    int32_t age;                            // Frames since the track started
+    int32_t missed;                         // Frames since it was last detected (0 = detected in this frame)
+    float confidence;                       // In [0, 1]
+    int32_t reserved;
+};
+
+struct StreamFrame {                        // Everything published for one frame
+    int64_t frameIndex;
+    double timestampMilliseconds;           // Capture time given by the frame source
+    double publishMilliseconds;             // Steady clock when the record was published
+    int32_t markerCount;
+    int32_t coneCount;
+    int32_t trackCount;
+    int32_t reserved;
+    StreamMarker markers[streamMaxMarkers];
+    StreamCone cones[streamMaxCones];
+    StreamTrack tracks[streamMaxTracks];
+};
+
+struct alignas(64) DetectionStreamSlot {
+    std::atomic<uint64_t> sequence;         // Odd while written, 2 * (frame number + 1) once complete, 0 if never written
+    StreamFrame frame;
+};
+
+struct alignas(64) DetectionStreamHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t slotCount;
+    uint64_t slotBytes;                     // sizeof(DetectionStreamSlot) of the publisher
+    alignas(64) std::atomic<uint64_t> published;    // Frames published so far, on its own cache line
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the sequences are shared between processes, they must not use a lock");
+
+class DetectionSubscriber {                 // Reads the records of a publisher, one subscriber per thread
+public:
+    DetectionSubscriber() {}
+    ~DetectionSubscriber() { close(); }
+
+    DetectionSubscriber(const DetectionSubscriber&) = delete;
+    DetectionSubscriber& operator=(const DetectionSubscriber&) = delete;
+
+    bool open(const std::string& name = defaultDetectionStream);    // Starts after the frames already published
+    void close();
+
+    bool isOpen() const { return header != nullptr; }
+    const std::string& error() const { return lastError; }
+
+    bool next(StreamFrame& frame);          // Oldest frame not read yet, false if there is none
+    bool latest(StreamFrame& frame);        // Newest frame, skipping whatever was not read, false if there is no new one
+
+    uint64_t published() const { return header->published.load(std::memory_order_acquire); }
+    uint64_t dropped() const { return droppedFrames; }     // Frames overwritten before they were read
+
+private:
+    bool read(uint64_t number, StreamFrame& frame) const;   // False if frame number was overwritten during the copy
+
+    const DetectionStreamHeader* header = nullptr;
+    const DetectionStreamSlot* slots = nullptr;
+    size_t size = 0;
+    uint64_t cursor = 0;                    // Number of the next frame to read
+    uint64_t droppedFrames = 0;
+    std::string lastError;
+};
@@ -0,0 +1,178 @@
+#include "Fourier.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cv;
+
+void takeDFT(Mat& source, Mat& destination) {
+
+    dft(source, destination, DFT_COMPLEX_OUTPUT);               // Real input, full complex spectrum: no need to merge a plane of zeros
+
+}
+
+void recenterDFT (Mat& source) {                                // Recenter DFT function
+
+    /*
+        We change around the quadrants of the DFT image so that the high
+        frequency data is at the edges and the low frequency data is at
+        the center (this is usually how DFT images are presented).
+
+        Quadrant 1 is swapped with quadrant 4 and quadrant 2 with quadrant 3,
+        row by row and in place, without a temporary matrix.
+    */
+
+    int centerX = source.cols/2;                                // Define center column of image
+    int centerY = source.rows/2;                                // Define center row of image
+    size_t halfRow = centerX * source.elemSize();               // Bytes in one row of a quadrant
+
+    for (int y = 0; y < centerY; y++) {
+        uchar* top = source.ptr<uchar>(y);                      // Row of quadrants 1 and 2
+        uchar* bottom = source.ptr<uchar>(y + centerY);         // Matching row of quadrants 3 and 4
+
+        swap_ranges(top, top + halfRow, bottom + halfRow);      // Quadrant 1 <-> quadrant 4
+        swap_ranges(top + halfRow, top + 2 * halfRow, bottom);  // Quadrant 2 <-> quadrant 3
+    }
+
+}
+
+void invertDFT(Mat& source, Mat& destination) {                             // Function to invert the DFT to get original image
+
+    dft(source, destination, DFT_INVERSE | DFT_REAL_OUTPUT | DFT_SCALE);    // call dft with the flags to invert, only retain the real ouput value, and scale the image.
+}
+
+Size DftPlan::optimalSize(Size size) {
+
+    return Size(2 * getOptimalDFTSize((size.width + 1) / 2), 2 * getOptimalDFTSize((size.height + 1) / 2));  // Even, so that recenterDFT swaps whole quadrants
+}
+
+void DftPlan::forward(const Mat& source, double scale) {
+
+    TRACE_SCOPE("forwardDFT");
+
+    CV_Assert(source.channels() == 1 && !source.empty());
+
+    Size size = optimalSize(source.size());
+    if (padded.size() != size || sourceSize != source.size()) {        // The padding only has to be cleared when the sizes change
+        padded.create(size, CV_32F);
+        padded.setTo(Scalar::all(0));
+        sourceSize = source.size();
+    }
+
+    Mat image = padded(Rect(Point(0, 0), sourceSize));
+    source.convertTo(image, CV_32F, scale);                             // Converted directly into the padded buffer
+
+    dft(padded, frequencies, DFT_COMPLEX_OUTPUT, sourceSize.height);    // Rows below the image are zero, let dft skip them
+}
+
+void DftPlan::inverse(Mat& destination) {
+
+    TRACE_SCOPE("inverseDFT");
+
+    CV_Assert(!frequencies.empty());
+
+    dft(frequencies, real, DFT_INVERSE | DFT_REAL_OUTPUT | DFT_SCALE, sourceSize.height);  // Only the rows of the image are needed
+    destination = real(Rect(Point(0, 0), sourceSize));                  // View into the plan, overwritten by the next inverse()
+}
+
+void DftPlan::logMagnitude(Mat& destination) const {
+
+    CV_Assert(!frequencies.empty());
+    destination.create(frequencies.size(), CV_32F);
+
+    for (int y = 0; y < frequencies.rows; y++) {                        // Straight from the interleaved spectrum, no split()
+        const Vec2f* in = frequencies.ptr<Vec2f>(y);
+        float* out = destination.ptr<float>(y);
+        for (int x = 0; x < frequencies.cols; x++) {
+            out[x] = std::log(1.0f + std::sqrt(in[x][0] * in[x][0] + in[x][1] * in[x][1]));
+        }
+    }
+}
+
+void FrequencyFilter::setLowPass(double cutoff) {
+
+    CV_Assert(cutoff > 0.0);
+    filterMode = LOW_PASS;
+    highCutoff = cutoff;
+    response.release();                                                 // Rebuilt by the next apply()
+}
+
+void FrequencyFilter::setBandPass(double low, double high) {
+
+    CV_Assert(low >= 0.0 && low < high);
+    filterMode = BAND_PASS;
+    lowCutoff = low;
+    highCutoff = high;
+    response.release();
+}
+
+void FrequencyFilter::setTemplate(const Mat& templ) {
+
+    CV_Assert(templ.channels() == 1 && !templ.empty());
+    filterMode = CORRELATION;
+    templ.convertTo(templateImage, CV_32F);
+    templateImage -= mean(templateImage);                               // Zero mean, so that bright areas do not correlate with everything
+    response.release();
+}
+
+void FrequencyFilter::buildResponse(Size paddedSize) {
+
+    if (filterMode == CORRELATION) {
+        CV_Assert(templateImage.cols <= paddedSize.width && templateImage.rows <= paddedSize.height);
+
+        Mat paddedTemplate = Mat::zeros(paddedSize, CV_32F);            // Same padded size as the frames, so that the spectra can be multiplied
+        templateImage.copyTo(paddedTemplate(Rect(Point(0, 0), templateImage.size())));
+        templatePlan.forward(paddedTemplate);
+        response = templatePlan.spectrum();
+        return;
+    }
+
+    /*
+        Gaussian responses on the frequency radius, normalized so that 1 is
+        the Nyquist frequency. The spectrum is not recentered: frequency x
+        and frequency width - x are the same, hence the min().
+    */
+
+    response.create(paddedSize, CV_32FC2);
+
+    double highScale = -0.5 / (highCutoff * highCutoff);
+    double lowScale = lowCutoff > 0.0 ? -0.5 / (lowCutoff * lowCutoff) : 0.0;
+
+    vector<float> columnFrequency(paddedSize.width);                   // Squared horizontal frequency of every column
+    for (int x = 0; x < paddedSize.width; x++) {
+        float fx = 2.0f * min(x, paddedSize.width - x) / paddedSize.width;
+        columnFrequency[x] = fx * fx;
+    }
+
+    for (int y = 0; y < paddedSize.height; y++) {
+        float fy = 2.0f * min(y, paddedSize.height - y) / paddedSize.height;
+        Vec2f* out = response.ptr<Vec2f>(y);
+
+        for (int x = 0; x < paddedSize.width; x++) {
+            double radius2 = columnFrequency[x] + fy * fy;
+            double gain = std::exp(highScale * radius2);
+            if (filterMode == BAND_PASS && lowCutoff > 0.0) {
+                gain -= std::exp(lowScale * radius2);                   // Difference of Gaussians
+            }
+            out[x] = Vec2f((float)gain, 0.0f);
+        }
+    }
+}
+
+void FrequencyFilter::apply(const Mat& source, Mat& destination) {
+
+    TRACE_SCOPE("frequencyFilter");
+
+    framePlan.forward(source);
+
+    if (filterMode != NONE) {
+        if (response.size() != framePlan.paddedSize()) {
+            buildResponse(framePlan.paddedSize());
+        }
+        mulSpectrums(framePlan.spectrum(), response, framePlan.spectrum(), 0, filterMode == CORRELATION);   // Conjugate of the template: correlation, not convolution
+    }
+
+    framePlan.inverse(destination);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+/*
+    Fourier transforms of single channel images.
+
+    DftPlan owns every buffer of a forward/inverse transform and keeps them
+    from one call to the next, so a stream of frames of the same size does
+    not allocate. The input is padded (with zeros, on the right and bottom)
+    to an even size that getOptimalDFTSize likes, converted to float in
+    place and transformed as a real image with DFT_COMPLEX_OUTPUT: no
+    imaginary plane of zeros and no merge().
+
+    FrequencyFilter multiplies the spectrum of every frame by a fixed
+    response (Gaussian low-pass, band-pass, or the conjugate spectrum of a
+    template for correlation). The response is only rebuilt when the frame
+    size changes.
+*/
+
+void takeDFT(cv::Mat& source, cv::Mat& destination);           // Complex DFT of a single channel float image
+
+void recenterDFT(cv::Mat& source);                              // Swap quadrants so that the low frequencies are at the center, in place
+
+void invertDFT(cv::Mat& source, cv::Mat& destination);         // Inverse DFT back to a real image
+
+class DftPlan {
+public:
+    void forward(const cv::Mat& source, double scale = 1.0);   // Spectrum of a single channel image of any depth, values multiplied by scale
+    void inverse(cv::Mat& destination);                         // Real image of the (possibly modified) spectrum, at the size given to forward()
+
+    void logMagnitude(cv::Mat& destination) const;              // log(1 + |spectrum|), CV_32F, not recentered
+
+    cv::Mat& spectrum() { return frequencies; }                 // CV_32FC2, paddedSize()
+    const cv::Mat& spectrum() const { return frequencies; }
+
+    cv::Size imageSize() const { return sourceSize; }
+    cv::Size paddedSize() const { return padded.size(); }
+
+    static cv::Size optimalSize(cv::Size size);                 // Smallest even size >= size with fast transforms
+
+private:
+    cv::Size sourceSize;
+    cv::Mat padded;                                             // Real input, zero outside of the image
+    cv::Mat frequencies;
+    cv::Mat real;                                               // Real output of the inverse transform
+};
+
+class FrequencyFilter {
+public:
+    enum Mode {
+        NONE,
+        LOW_PASS,
+        BAND_PASS,
+        CORRELATION
+    };
+
+    void setLowPass(double cutoff);                             // Cutoffs are fractions of the Nyquist frequency, in (0, 1]
+    void setBandPass(double low, double high);
+    void setTemplate(const cv::Mat& templ);                     // Single channel, smaller than the frames
+
+    void apply(const cv::Mat& source, cv::Mat& destination);    // Filtered image (correlation map for CORRELATION), CV_32F, same size as source
+
+    Mode mode() const { return filterMode; }
+    DftPlan& plan() { return framePlan; }                       // Spectrum of the last frame passed to apply()
+
+private:
+    void buildResponse(cv::Size paddedSize);
+
+    Mode filterMode = NONE;
+    double lowCutoff = 0.0, highCutoff = 1.0;
+    cv::Mat templateImage;
+
+    DftPlan framePlan;
+    DftPlan templatePlan;
+    cv::Mat response;                                           // CV_32FC2, multiplied with the spectrum of every frame
+};
@@ -0,0 +1,99 @@
+#include "FrameBudget.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+const char* qualityLevelName(QualityLevel level) {
+
+    switch (level) {
+        case QUALITY_FULL: return "full";
+        case QUALITY_COARSE: return "coarse";
+        case QUALITY_ROI: return "roi";
+        case QUALITY_NO_POSE: return "no pose";
+        case QUALITY_NO_DRAWING: return "no drawing";
+        default: return "?";
+    }
+}
+
+FrameBudgetScheduler::FrameBudgetScheduler(const FrameBudgetSettings& settings) : settings(settings), recoveryNeeded(settings.recoveryFrames) {}
+
+void FrameBudgetScheduler::frameDone(QualityLevel frameLevel, chrono::steady_clock::duration work) {
+
+    workPerLevel[frameLevel].record(work);
+    framesSinceChange++;
+
+    int level = current.load(memory_order_relaxed);
+    if (frameLevel != level) {                                                  // Stamped before the last change, it says nothing about the current level
+        return;
+    }
+
+    double milliseconds = chrono::duration<double, milli>(work).count();
+    overBudget = milliseconds > settings.budgetMilliseconds ? overBudget + 1 : 0;
+    underBudget = milliseconds < settings.headroom * settings.budgetMilliseconds ? underBudget + 1 : 0;
+    changeLevel();
+}
+
+void FrameBudgetScheduler::framesDropped(uint64_t count) {
+
+    if (count == 0) {
+        return;
+    }
+    dropped += count;
+    framesSinceChange += (int)count;
+    overBudget += (int)count;                                                   // The pipeline fell behind: as bad as a frame over budget
+    underBudget = 0;
+    changeLevel();
+}
+
+void FrameBudgetScheduler::changeLevel() {
+
+    int level = current.load(memory_order_relaxed);
+    if (overBudget >= settings.overBudgetFrames && level < settings.lowest) {
+        if (lastChangeWasUp && framesSinceChange <= recoveryNeeded) {           // The level above was already too slow: wait longer before trying it again
+            recoveryNeeded = min(2 * recoveryNeeded, settings.maxRecoveryFrames);
+        }
+        level++;
+        if (level == QUALITY_ROI && !settings.roi && level < settings.lowest) {
+            level++;
+        }
+        lastChangeWasUp = false;
+    } else if (underBudget >= recoveryNeeded && level > QUALITY_FULL) {
+        if (lastChangeWasUp || framesSinceChange > 2 * recoveryNeeded) {        // The last step up held, or the load has been stable for a while
+            recoveryNeeded = settings.recoveryFrames;
+        }
+        level--;
+        if (level == QUALITY_ROI && !settings.roi) {
+            level--;
+        }
+        lastChangeWasUp = true;
+    } else {
+        return;
+    }
+
+    current.store(level, memory_order_relaxed);
+    overBudget = underBudget = 0;
+    framesSinceChange = 0;
+    changes++;
+}
+
+void printFrameBudgetReport(ostream& out, const FrameBudgetScheduler& scheduler) {
+
+    uint64_t total = 0;
+    for (int level = 0; level < qualityLevelCount; level++) {
+        total += scheduler.frames((QualityLevel)level);
+    }
+    if (total == 0) {
+        return;
+    }
+
+    out << "Frame budget " << scheduler.budget().budgetMilliseconds << " ms, " << scheduler.levelChanges() << " quality changes, " << scheduler.droppedFrames() << " frames dropped:" << endl;
+    for (int level = 0; level < qualityLevelCount; level++) {
+        const LatencyHistogram& work = scheduler.work((QualityLevel)level);
+        if (work.count() == 0) {                                                // Levels never used
+            continue;
+        }
+        out << "   " << qualityLevelName((QualityLevel)level) << ": " << work.count() << " frames (" << 100.0 * work.count() / total << "%), work p50 " << work.percentileMilliseconds(0.5)
+            << " ms, p99 " << work.percentileMilliseconds(0.99) << " ms, max " << work.maxMilliseconds() << " ms" << endl;
+    }
+}
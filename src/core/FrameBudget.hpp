@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#include "LatencyStats.hpp"
+
+/*
+    Frame budget: keeps the work spent on every frame under a deadline (the
+    16 ms of a 60 Hz camera) by lowering the quality of the processing
+    instead of falling behind and dropping frames.
+
+    The levels are cumulative, each one gives up a little more:
+
+        full         detection as configured, pose, overlays
+        coarse       detection one pyramid level further down
+        roi          only search around the previous detections
+        no pose      markers are found but not positioned
+        no drawing   nothing drawn or shown
+
+    Each frame is stamped with the current level when it enters the
+    pipeline, so every stage works on it at the same level. The stages add
+    their time to the frame. Once the frame is done, the scheduler steps one
+    level down after a few consecutive frames over budget. It steps back up
+    after a longer run of frames well under budget. A level that goes over
+    budget again right after stepping up must wait twice as long before the
+    next try, so an overloaded machine does not oscillate. Frames the
+    pipeline drops because a stage fell behind count as over budget. A
+    pipeline that cannot track (several detection workers, none of them sees
+    every frame) turns the roi level off and the scheduler steps over it.
+
+    The frames and their cost are counted per level, to see how much of a
+    run a machine spends degraded and what each level costs on it.
+*/
+
+enum QualityLevel {
+    QUALITY_FULL,
+    QUALITY_COARSE,
+    QUALITY_ROI,
+    QUALITY_NO_POSE,
+    QUALITY_NO_DRAWING,
+    qualityLevelCount
+};
+
+const char* qualityLevelName(QualityLevel level);
+
+struct FrameBudgetSettings {
+    double budgetMilliseconds = 16.6;       // Work allowed per frame
+    double headroom = 0.7;                  // Step up when frames take less than this fraction of the budget...
+    int recoveryFrames = 30;                // ...for this many frames in a row
+    int overBudgetFrames = 3;               // Step down after this many frames in a row over budget
+    int maxRecoveryFrames = 960;            // Longest wait before stepping up again, after repeated failures
+    QualityLevel lowest = QUALITY_NO_DRAWING;
+    bool roi = true;                        // Off when the detection cannot search around the previous frame
+};
+
+class FrameBudgetScheduler {
+public:
+    explicit FrameBudgetScheduler(const FrameBudgetSettings& settings = FrameBudgetSettings());
+
+    QualityLevel level() const { return (QualityLevel)current.load(std::memory_order_relaxed); }    // Any thread, stamp it on the frame
+
+    void frameDone(QualityLevel frameLevel, std::chrono::steady_clock::duration work);    // One thread, once per frame, in about frame order
+    void framesDropped(uint64_t count);     // Same thread, frames the pipeline dropped since the last call
+
+    const FrameBudgetSettings& budget() const { return settings; }
+    uint64_t frames(QualityLevel level) const { return workPerLevel[level].count(); }
+    const LatencyHistogram& work(QualityLevel level) const { return workPerLevel[level]; }
+    int levelChanges() const { return changes; }
+    uint64_t droppedFrames() const { return dropped; }
+
+private:
+    void changeLevel();                     // Step down or up on the frames in a row
+
+    FrameBudgetSettings settings;
+    std::atomic<int> current{QUALITY_FULL};
+    int overBudget = 0, underBudget = 0;    // Frames in a row
+    int recoveryNeeded;                     // Frames under budget before the next step up
+    int framesSinceChange = 0;
+    bool lastChangeWasUp = false;
+    int changes = 0;
+    uint64_t dropped = 0;
+    LatencyHistogram workPerLevel[qualityLevelCount];
+};
+
+void printFrameBudgetReport(std::ostream& out, const FrameBudgetScheduler& scheduler);
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "RingBuffer.hpp"
+
+/*
+    Fixed set of preallocated frame slots shared by all the stages of a
+    pipeline. A slot holds whatever one frame needs (image, corner and ID
+    buffers...) and is handed around as a reference-counted FrameRef: when
+    the last reference goes away (the frame was shown, or dropped by a
+    queue), the slot goes back to the free list and is reused, buffers
+    included, for a later frame.
+
+    Nothing is allocated after construction: the free list is a RingBuffer
+    of slot indices and the reference count lives in the slot.
+*/
+
+template <typename T>
+class FramePool;
+
+template <typename T>
+class FrameRef {                                                        // Shared handle on one slot of a FramePool
+public:
+    FrameRef() {}
+    FrameRef(const FrameRef& other) : pool(other.pool), index(other.index) { retain(); }
+    FrameRef(FrameRef&& other) noexcept : pool(other.pool), index(other.index) { other.pool = nullptr; }
+    ~FrameRef() { release(); }
+
+    FrameRef& operator=(const FrameRef& other) {
+        if (this != &other) {
+            release();
+            pool = other.pool;
+            index = other.index;
+            retain();
+        }
+        return *this;
+    }
+
+    FrameRef& operator=(FrameRef&& other) noexcept {
+        if (this != &other) {
+            release();
+            pool = other.pool;
+            index = other.index;
+            other.pool = nullptr;
+        }
+        return *this;
+    }
+
+    explicit operator bool() const { return pool != nullptr; }
+
+    T& operator*() const { return pool->slots[index].value; }
+    T* operator->() const { return &pool->slots[index].value; }
+
+    void reset() { release(); }
+
+private:
+    friend class FramePool<T>;
+
+    FrameRef(FramePool<T>* owner, size_t slotIndex) : pool(owner), index(slotIndex) {}
+
+    void retain() {
+        if (pool != nullptr) {
+            pool->slots[index].references.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void release() {
+        if (pool != nullptr) {
+            pool->release(index);
+            pool = nullptr;
+        }
+    }
+
+    FramePool<T>* pool = nullptr;
+    size_t index = 0;
+};
+
+template <typename T>
+class FramePool {
+public:
+    explicit FramePool(size_t capacity) : slotCount(capacity), slots(new Slot[capacity]), freeSlots(capacity) {
+        for (size_t i = 0; i < capacity; i++) {
+            slots[i].references.store(0, std::memory_order_relaxed);
+            freeSlots.tryPush(size_t(i));
+        }
+    }
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    template <typename Function>
+    void forEachSlot(Function function) {                               // Preallocate the buffers of every slot, before the pool is shared
+        for (size_t i = 0; i < slotCount; i++) {
+            function(slots[i].value);
+        }
+    }
+
+    FrameRef<T> acquire() {                                             // A free slot, or an empty reference if every slot is in use
+        size_t index;
+        if (!freeSlots.tryPop(index)) {
+            exhaustedCount.fetch_add(1, std::memory_order_relaxed);
+            return FrameRef<T>();
+        }
+
+        slots[index].references.store(1, std::memory_order_relaxed);
+        return FrameRef<T>(this, index);
+    }
+
+    size_t capacity() const { return slotCount; }
+    size_t exhausted() const { return exhaustedCount.load(std::memory_order_relaxed); }   // How many times acquire() found no free slot
+
+private:
+    friend class FrameRef<T>;
+
+    struct Slot {
+        std::atomic<int> references;
+        T value;
+    };
+
+    void release(size_t index) {
+        if (slots[index].references.fetch_sub(1, std::memory_order_acq_rel) == 1) {       // Last reference: the slot is free again
+            freeSlots.tryPush(size_t(index));                           // Never full, it has room for every slot
+        }
+    }
+
+    size_t slotCount;
+    std::unique_ptr<Slot[]> slots;
+    RingBuffer<size_t> freeSlots;
+    std::atomic<size_t> exhaustedCount{0};
+};
@@ -0,0 +1,193 @@
+#include "FrameSource.hpp"
+#include "Trace.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+using namespace cv;
+
+bool VideoFileSource::read(Mat& frame, double& timestampMilliseconds) {
+
+    if (!vid.read(frame)) {
+        return false;
+    }
+    timestampMilliseconds = vid.get(CAP_PROP_POS_MSEC);                // Media time, the same on every run
+    return true;
+}
+
+Size VideoFileSource::frameSize() const {
+
+    return Size((int)vid.get(CAP_PROP_FRAME_WIDTH), (int)vid.get(CAP_PROP_FRAME_HEIGHT));
+}
+
+bool SessionSource::read(Mat& frame, double& timestampMilliseconds) {
+
+    if (next >= reader.frameCount()) {
+        return false;
+    }
+
+    timestampMilliseconds = reader.timestamp(next);
+
+    if (paced) {                                                        // Hand the frame out when it is due, relative to the first one
+        if (next == 0) {
+            replayStart = chrono::steady_clock::now();
+        }
+        chrono::duration<double, milli> offset(timestampMilliseconds - reader.timestamp(0));
+        this_thread::sleep_until(replayStart + chrono::duration_cast<chrono::steady_clock::duration>(offset));
+    }
+
+    return reader.frame(next++, frame);
+}
+
+static bool isDeviceIndex(const string& source) {                      // A plain number is a camera, anything else a file
+    return !source.empty() && source.find_first_not_of("0123456789") == string::npos;
+}
+
+LiveCameraSource::LiveCameraSource(const string& device, const LiveCameraSettings& settings) {
+
+    standIn = settings.standIn || !isDeviceIndex(device);
+
+    if (standIn) {                                                      // A video file paced like a camera, so the live path can be tested without one
+        vid.open(device);
+        double fps = settings.fps > 0.0 ? settings.fps : vid.get(CAP_PROP_FPS);
+        standInPeriod = 1000.0 / (fps > 0.0 ? fps : 30.0);
+    } else {
+        int index = atoi(device.c_str());
+        if (!vid.open(index, CAP_V4L2)) {                               // V4L2 directly, the other backends ignore most of the settings below
+            vid.open(index);
+        }
+
+        if (vid.isOpened()) {
+            if (settings.fourcc.size() == 4) {                          // Has to come before the resolution
+                vid.set(CAP_PROP_FOURCC, VideoWriter::fourcc(settings.fourcc[0], settings.fourcc[1], settings.fourcc[2], settings.fourcc[3]));
+            }
+            if (settings.resolution.area() > 0) {
+                vid.set(CAP_PROP_FRAME_WIDTH, settings.resolution.width);
+                vid.set(CAP_PROP_FRAME_HEIGHT, settings.resolution.height);
+            }
+            if (settings.fps > 0.0) {
+                vid.set(CAP_PROP_FPS, settings.fps);
+            }
+            vid.set(CAP_PROP_BUFFERSIZE, 1);                            // No queue of stale frames in the driver
+
+            if (settings.exposure >= 0.0) {                             // Locked exposure: constant frame timing and brightness
+                vid.set(CAP_PROP_AUTO_EXPOSURE, 1);                     // V4L2_EXPOSURE_MANUAL
+                vid.set(CAP_PROP_EXPOSURE, settings.exposure);
+            } else {
+                vid.set(CAP_PROP_AUTO_EXPOSURE, 3);                     // V4L2_EXPOSURE_APERTURE_PRIORITY
+            }
+        }
+    }
+
+    if (!vid.isOpened()) {
+        return;
+    }
+
+    opened = true;
+    size = Size((int)vid.get(CAP_PROP_FRAME_WIDTH), (int)vid.get(CAP_PROP_FRAME_HEIGHT));  // What the driver agreed to
+    grabber = thread(&LiveCameraSource::grabLoop, this);
+}
+
+void LiveCameraSource::grabLoop() {
+
+    TRACE_THREAD("grab");
+
+    Mat grabbed;                                                        // Filled here, then swapped with the newest frame
+    auto nextTick = chrono::steady_clock::now();
+
+    while (!stopping.load()) {
+        if (standIn) {
+            nextTick += chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, milli>(standInPeriod));
+            this_thread::sleep_until(nextTick);
+        }
+
+        if (!vid.grab()) {
+            break;
+        }
+
+        double now = steadyMilliseconds();
+        double timestamp = standIn ? now : vid.get(CAP_PROP_POS_MSEC);  // V4L2 buffer timestamp, taken by the driver when the frame arrived
+        if (fabs(timestamp - now) > 1000.0) {                           // No usable driver timestamp (or another clock): take ours
+            timestamp = now;
+        }
+
+        bool retrieved;
+        {
+            TRACE_SCOPE("retrieve");
+            retrieved = vid.retrieve(grabbed);                          // Decodes MJPEG here, off the consumer's thread
+        }
+        if (!retrieved) {
+            break;
+        }
+
+        {
+            lock_guard<mutex> lock(latestMutex);
+            if (latestSequence > readSequence) {                        // The previous frame was never read
+                skippedFrames.fetch_add(1, memory_order_relaxed);
+            }
+            swap(latest, grabbed);                                      // Buffers go back and forth, nothing is allocated after the first frames
+            latestTimestamp = timestamp;
+            latestSequence++;
+        }
+        frameReady.notify_one();
+    }
+
+    {
+        lock_guard<mutex> lock(latestMutex);
+        ended = true;
+    }
+    frameReady.notify_all();
+}
+
+bool LiveCameraSource::read(Mat& frame, double& timestampMilliseconds) {
+
+    unique_lock<mutex> lock(latestMutex);
+    frameReady.wait(lock, [&]() { return latestSequence > readSequence || ended; });
+
+    if (latestSequence == readSequence) {                               // Camera gone (or end of the stand-in file)
+        return false;
+    }
+
+    latest.copyTo(frame);                                               // The caller's buffer is reused, latest stays with the grab thread
+    timestampMilliseconds = latestTimestamp;
+    readSequence = latestSequence;
+    return true;
+}
+
+void LiveCameraSource::stop() {
+
+    stopping.store(true);
+    if (grabber.joinable()) {
+        grabber.join();
+    }
+}
+
+unique_ptr<FrameSource> openFrameSource(const string& path, bool realtime, const LiveCameraSettings& camera) {
+
+    if (isDeviceIndex(path) || camera.standIn) {
+        unique_ptr<LiveCameraSource> live(new LiveCameraSource(path, camera));
+        if (!live->isOpened()) {
+            cout << "Could not open camera " << path << endl;
+            return nullptr;
+        }
+        return move(live);
+    }
+
+    if (SessionReader::isSessionFile(path)) {
+        unique_ptr<SessionSource> session(new SessionSource(realtime));
+        if (!session->open(path)) {
+            cout << "Could not replay " << path << ": " << session->error() << endl;
+            return nullptr;
+        }
+        return move(session);
+    }
+
+    unique_ptr<VideoFileSource> video(new VideoFileSource(path));
+    if (!video->isOpened()) {
+        cout << "Could not open " << path << endl;
+        return nullptr;
+    }
+    return move(video);
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "SessionFile.hpp"
+
+/*
+    Where the frames of a tool come from. Every source hands out frames
+    together with their capture timestamp, so results can be tied to the
+    moment the frame was taken whatever produced it: a video file (media
+    time), a recorded session (the timestamps of the original run),
+    replayed as fast as possible or at the recorded pace, or a live camera.
+
+    A live camera is grabbed on its own thread, which only ever keeps the
+    newest frame: a slow consumer skips frames instead of working through
+    a backlog, and the driver queue is reduced to one buffer for the same
+    reason. Live timestamps are on the steady clock (the V4L2 buffer
+    timestamp when the driver gives one), so the latency from the sensor to
+    any later stage is steadyMilliseconds() minus the frame timestamp.
+*/
+
+inline double steadyMilliseconds(std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now()) {  // Live timestamps are on this clock
+    return std::chrono::duration<double, std::milli>(time.time_since_epoch()).count();
+}
+
+inline std::chrono::steady_clock::time_point steadyTimePoint(double milliseconds) {
+    return std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(milliseconds)));
+}
+
+class FrameSource {
+public:
+    virtual ~FrameSource() {}
+
+    virtual bool read(cv::Mat& frame, double& timestampMilliseconds) = 0;  // Next frame and its capture time, false at the end
+    virtual cv::Size frameSize() const = 0;                                 // Empty if not known before the first frame
+    virtual bool isLive() const { return false; }                           // Timestamps are on the steady clock
+};
+
+class VideoFileSource : public FrameSource {        // Anything VideoCapture can open, decoded frame by frame
+public:
+    explicit VideoFileSource(const std::string& path) : vid(path) {}
+
+    bool isOpened() const { return vid.isOpened(); }
+
+    bool read(cv::Mat& frame, double& timestampMilliseconds) override;
+    cv::Size frameSize() const override;
+
+private:
+    mutable cv::VideoCapture vid;                   // get() is not const
+};
+
+class SessionSource : public FrameSource {          // Frames of a recorded session, no decoding for raw sessions
+public:
+    explicit SessionSource(bool realtime = false) : paced(realtime) {}
+
+    bool open(const std::string& path) { return reader.open(path); }
+    const std::string& error() const { return reader.error(); }
+    const SessionReader& session() const { return reader; }
+
+    bool read(cv::Mat& frame, double& timestampMilliseconds) override;
+    cv::Size frameSize() const override { return reader.frameSize(); }
+
+private:
+    SessionReader reader;
+    bool paced;                                     // Wait for the recorded time of every frame
+    size_t next = 0;
+    std::chrono::steady_clock::time_point replayStart;
+};
+
+struct LiveCameraSettings {
+    cv::Size resolution;                            // Driver default when empty
+    double fps = 0.0;                               // Driver default (or the file's rate for a stand-in) when 0
+    std::string fourcc = "MJPG";                    // MJPG (less USB bandwidth) or YUYV (no decode), driver default when empty
+    double exposure = -1.0;                         // Locked to this value (driver units) when >= 0, automatic otherwise
+    bool standIn = false;                           // Play a video file as if it were this camera
+};
+
+class LiveCameraSource : public FrameSource {
+public:
+    LiveCameraSource(const std::string& device, const LiveCameraSettings& settings = LiveCameraSettings());    // Camera index, or a video file for a stand-in
+    ~LiveCameraSource() { stop(); }
+
+    LiveCameraSource(const LiveCameraSource&) = delete;
+    LiveCameraSource& operator=(const LiveCameraSource&) = delete;
+
+    bool isOpened() const { return opened; }
+
+    bool read(cv::Mat& frame, double& timestampMilliseconds) override;     // Waits for a frame newer than the last one read
+    cv::Size frameSize() const override { return size; }
+    bool isLive() const override { return true; }
+
+    size_t skipped() const { return skippedFrames.load(std::memory_order_relaxed); }   // Frames replaced by a newer one before anybody read them
+    void stop();
+
+private:
+    void grabLoop();
+
+    cv::VideoCapture vid;                           // Only used by the grab thread once it runs
+    bool opened = false;
+    bool standIn = false;
+    double standInPeriod = 0.0;                     // [ms] between two frames of a stand-in
+    cv::Size size;
+
+    std::thread grabber;
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> skippedFrames{0};
+
+    std::mutex latestMutex;                         // Guards everything below
+    std::condition_variable frameReady;
+    cv::Mat latest;                                 // Newest frame, swapped with the grab thread's buffer
+    double latestTimestamp = 0.0;
+    uint64_t latestSequence = 0, readSequence = 0;
+    bool ended = false;
+};
+
+std::unique_ptr<FrameSource> openFrameSource(const std::string& path, bool realtime = false, const LiveCameraSettings& camera = LiveCameraSettings());   // Camera index, session file or video, nullptr (and a message) if it cannot be opened
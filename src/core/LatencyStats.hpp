@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/*
+    Lock-free latency histogram, one per pipeline or benchmark stage. Several
+    worker threads can record into the same histogram while another thread
+    reads it.
+
+    Buckets are log-linear: every power of two is split into 32 sub-buckets,
+    so percentiles are exact to within ~3% from nanoseconds up to minutes
+    without storing the individual samples. Mean and max are tracked exactly.
+*/
+
+class LatencyHistogram {
+public:
+    LatencyHistogram() {
+        for (std::atomic<uint64_t>& bucket : buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(std::chrono::steady_clock::duration elapsed) {          // Add one measurement
+        int64_t signedNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        uint64_t nanoseconds = signedNanoseconds > 0 ? (uint64_t)signedNanoseconds : 0;
+
+        buckets[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        samples.fetch_add(1, std::memory_order_relaxed);
+        totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+        uint64_t currentMax = maxNanoseconds.load(std::memory_order_relaxed);
+        while (nanoseconds > currentMax && !maxNanoseconds.compare_exchange_weak(currentMax, nanoseconds, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t count() const { return samples.load(std::memory_order_relaxed); }
+
+    double meanMilliseconds() const {
+        uint64_t n = count();
+        return n == 0 ? 0.0 : totalNanoseconds.load(std::memory_order_relaxed) / (1e6 * n);
+    }
+
+    double maxMilliseconds() const { return maxNanoseconds.load(std::memory_order_relaxed) / 1e6; }
+
+    double totalSeconds() const { return totalNanoseconds.load(std::memory_order_relaxed) / 1e9; }
+
+    double percentileMilliseconds(double fraction) const {              // e.g. 0.5 for the median, 0.99 for p99
+        uint64_t n = count();
+        if (n == 0) {
+            return 0.0;
+        }
+
+        uint64_t rank = (uint64_t)(fraction * n + 0.5);                 // Number of samples at or below the requested percentile
+        rank = rank < 1 ? 1 : (rank > n ? n : rank);
+
+        uint64_t seen = 0;
+        for (int i = 0; i < bucketCount; i++) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                double middle = bucketLowerBound(i) + bucketWidth(i) / 2.0;
+                double maximum = (double)maxNanoseconds.load(std::memory_order_relaxed);
+                return (middle < maximum ? middle : maximum) / 1e6;     // Never report more than what was actually measured
+            }
+        }
+        return maxMilliseconds();
+    }
+
+private:
+    static const int subBucketBits = 5;
+    static const int subBucketCount = 1 << subBucketBits;
+    static const int bucketCount = (64 - subBucketBits + 1) * subBucketCount;
+
+    static int bucketIndex(uint64_t value) {
+        if (value < (uint64_t)subBucketCount) {                         // Small values get one bucket each
+            return (int)value;
+        }
+        int highestBit = 63 - __builtin_clzll(value);
+        int shift = highestBit - subBucketBits;
+        int subBucket = (int)((value >> shift) & (subBucketCount - 1));
+        return (highestBit - subBucketBits + 1) * subBucketCount + subBucket;
+    }
+
+    static uint64_t bucketLowerBound(int index) {
+        if (index < subBucketCount) {
+            return (uint64_t)index;
+        }
+        int shift = index / subBucketCount - 1;
+        return (uint64_t)(subBucketCount + index % subBucketCount) << shift;
+    }
+
+    static uint64_t bucketWidth(int index) {
+        return index < subBucketCount ? 1 : (uint64_t)1 << (index / subBucketCount - 1);
+    }
+
+    std::atomic<uint64_t> buckets[bucketCount];
+    std::atomic<uint64_t> samples{0};
+    std::atomic<uint64_t> totalNanoseconds{0};
+    std::atomic<uint64_t> maxNanoseconds{0};
+};
+
+class ScopedLatency {                                                   // Records the time spent in a scope into a histogram
+public:
+    explicit ScopedLatency(LatencyHistogram& histogram) : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    ScopedLatency(LatencyHistogram& histogram, std::chrono::steady_clock::duration& total) : histogram(histogram), total(&total), start(std::chrono::steady_clock::now()) {}    // Also adds it to total (the work spent on one frame)
+    ~ScopedLatency() {
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+        histogram.record(elapsed);
+        if (total != nullptr) {
+            *total += elapsed;
+        }
+    }
+
+    ScopedLatency(const ScopedLatency&) = delete;
+    ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+private:
+    LatencyHistogram& histogram;
+    std::chrono::steady_clock::duration* total = nullptr;
+    std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,118 @@
+#include "MarkerDetection.hpp"
+#include "Trace.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+
+using namespace std;
+using namespace cv;
+
+template <typename T>
+static void readIfPresent(const FileNode& node, const char* key, T& value) {   // Keep the current value when the key is missing
+    if (!node[key].empty()) {
+        node[key] >> value;
+    }
+}
+
+bool loadDetectorConfig(const string& name, DetectorConfig& config) {
+
+    FileStorage fs(name, FileStorage::READ);
+    if (!fs.isOpened()) {
+        return false;
+    }
+
+    FileNode detector = fs["detector"];
+    aruco::DetectorParameters& p = *config.parameters;
+
+    readIfPresent(detector, "adaptiveThreshWinSizeMin", p.adaptiveThreshWinSizeMin);
+    readIfPresent(detector, "adaptiveThreshWinSizeMax", p.adaptiveThreshWinSizeMax);
+    readIfPresent(detector, "adaptiveThreshWinSizeStep", p.adaptiveThreshWinSizeStep);
+    readIfPresent(detector, "adaptiveThreshConstant", p.adaptiveThreshConstant);
+    readIfPresent(detector, "minMarkerPerimeterRate", p.minMarkerPerimeterRate);
+    readIfPresent(detector, "maxMarkerPerimeterRate", p.maxMarkerPerimeterRate);
+    readIfPresent(detector, "polygonalApproxAccuracyRate", p.polygonalApproxAccuracyRate);
+    readIfPresent(detector, "minCornerDistanceRate", p.minCornerDistanceRate);
+    readIfPresent(detector, "minDistanceToBorder", p.minDistanceToBorder);
+    readIfPresent(detector, "minMarkerDistanceRate", p.minMarkerDistanceRate);
+    readIfPresent(detector, "cornerRefinementWinSize", p.cornerRefinementWinSize);
+    readIfPresent(detector, "cornerRefinementMaxIterations", p.cornerRefinementMaxIterations);
+    readIfPresent(detector, "cornerRefinementMinAccuracy", p.cornerRefinementMinAccuracy);
+    readIfPresent(detector, "perspectiveRemovePixelPerCell", p.perspectiveRemovePixelPerCell);
+    readIfPresent(detector, "errorCorrectionRate", p.errorCorrectionRate);
+
+    if (!detector["cornerRefinementMethod"].empty()) {                  // none, subpix or contour
+        string method = (string)detector["cornerRefinementMethod"];
+        p.cornerRefinementMethod = method == "subpix" ? aruco::CORNER_REFINE_SUBPIX
+                                 : method == "contour" ? aruco::CORNER_REFINE_CONTOUR
+                                 : aruco::CORNER_REFINE_NONE;
+    }
+
+    FileNode pyramid = fs["pyramid"];
+    readIfPresent(pyramid, "levels", config.pyramidLevels);
+    readIfPresent(pyramid, "refineWindow", config.refineWindow);
+
+    return true;
+}
+
+PyramidMarkerDetector::PyramidMarkerDetector(const Ptr<aruco::Dictionary>& dictionary, const DetectorConfig& config)
+    : dictionary(dictionary), parameters(config.parameters), pyramidLevels(max(0, config.pyramidLevels)), refineWindow(config.refineWindow) {
+
+    coarseParameters = makePtr<aruco::DetectorParameters>(*config.parameters);
+    int scale = 1 << pyramidLevels;
+
+    aruco::DetectorParameters& coarse = *coarseParameters;             // Rates are relative to the image size, only sizes in pixels shrink
+    coarse.adaptiveThreshWinSizeMin = max(3, coarse.adaptiveThreshWinSizeMin / scale);
+    coarse.adaptiveThreshWinSizeMax = max(coarse.adaptiveThreshWinSizeMin, coarse.adaptiveThreshWinSizeMax / scale);
+    coarse.adaptiveThreshWinSizeStep = max(1, coarse.adaptiveThreshWinSizeStep / scale);
+    coarse.minDistanceToBorder = max(1, coarse.minDistanceToBorder / scale);
+    coarse.cornerRefinementMethod = aruco::CORNER_REFINE_NONE;         // Refined at full resolution instead
+
+    refineWindow = max(refineWindow, scale + 1);                        // The window has to cover the error of a coarse pixel
+}
+
+void PyramidMarkerDetector::detect(const Mat& frame, vector<vector<Point2f>>& markerCorners, vector<int>& markerIDs) {
+
+    TRACE_SCOPE("detectMarkers");
+
+    if (pyramidLevels == 0) {
+        aruco::detectMarkers(frame, dictionary, markerCorners, markerIDs, parameters);
+        return;
+    }
+
+    const Mat* full = &frame;
+    if (frame.channels() != 1) {
+        cvtColor(frame, grey, COLOR_BGR2GRAY);                          // Once, both the pyramid and the refinement use it
+        full = &grey;
+    }
+
+    pyramid.resize(pyramidLevels);
+    const Mat* level = full;
+    for (int i = 0; i < pyramidLevels; i++) {
+        pyrDown(*level, pyramid[i]);
+        level = &pyramid[i];
+    }
+
+    aruco::detectMarkers(*level, dictionary, markerCorners, markerIDs, coarseParameters);
+    if (markerIDs.empty()) {
+        return;
+    }
+
+    float scale = (float)(1 << pyramidLevels);                         // pyrDown samples sit on the even pixels of the level above
+    corners.clear();
+    for (const vector<Point2f>& marker : markerCorners) {
+        for (const Point2f& corner : marker) {
+            corners.push_back(corner * scale);
+        }
+    }
+
+    cornerSubPix(*full, corners, Size(refineWindow, refineWindow), Size(-1, -1),       // Every corner in one call, only small windows of the full image are read
+                 TermCriteria(TermCriteria::EPS | TermCriteria::COUNT, parameters->cornerRefinementMaxIterations, parameters->cornerRefinementMinAccuracy));
+
+    size_t k = 0;
+    for (vector<Point2f>& marker : markerCorners) {
+        for (Point2f& corner : marker) {
+            corner = corners[k++];
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/aruco.hpp>
+
+#include <string>
+#include <vector>
+
+/*
+    Coarse-to-fine marker detection for high resolution cameras. Candidates
+    are searched on a downscaled level of the image pyramid (half size per
+    level, so a quarter of the pixels), where thresholding and contour
+    extraction are cheap. The corners found there are then refined with a
+    sub-pixel search on the full resolution image, only inside small
+    windows around each corner.
+
+    Detector settings come from a config file (see detector.yml) instead
+    of the OpenCV defaults, so they can be tuned per camera.
+*/
+
+struct DetectorConfig {
+    cv::Ptr<cv::aruco::DetectorParameters> parameters = cv::aruco::DetectorParameters::create();   // For full resolution images
+    int pyramidLevels = 0;                  // 0 = detect at full resolution, 1 = half, 2 = quarter...
+    int refineWindow = 3;                   // Half size of the full resolution corner search window [px]
+};
+
+bool loadDetectorConfig(const std::string& name, DetectorConfig& config);  // Keys left out of the file keep their value, false if the file cannot be read
+
+class PyramidMarkerDetector {
+public:
+    PyramidMarkerDetector(const cv::Ptr<cv::aruco::Dictionary>& dictionary, const DetectorConfig& config);
+
+    void detect(const cv::Mat& frame, std::vector<std::vector<cv::Point2f>>& markerCorners, std::vector<int>& markerIDs);
+
+    int levels() const { return pyramidLevels; }
+
+private:
+    cv::Ptr<cv::aruco::Dictionary> dictionary;
+    cv::Ptr<cv::aruco::DetectorParameters> parameters;          // Full resolution, used when there is no pyramid
+    cv::Ptr<cv::aruco::DetectorParameters> coarseParameters;    // Pixel sizes scaled down to the coarse level, no corner refinement
+    int pyramidLevels;
+    int refineWindow;
+
+    cv::Mat grey;                                               // Buffers reused from frame to frame
+    std::vector<cv::Mat> pyramid;
+    std::vector<cv::Point2f> corners;
+};
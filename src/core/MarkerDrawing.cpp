@@ -0,0 +1,72 @@
+#include "MarkerDrawing.hpp"
+#include "Trace.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <cstdio>
+
+using namespace std;
+using namespace cv;
+
+void drawDetectedMarkerAxis(InputOutputArray _image, InputArrayOfArrays _corners, InputArray _ids, bool showID) {
+
+    TRACE_SCOPE("drawMarkers");
+
+    CV_Assert(_image.getMat().total() != 0 && (_image.getMat().channels() == 1 || _image.getMat().channels() == 3));
+    CV_Assert((_corners.total() == _ids.total()) || _ids.total() == 0);
+
+    int nMarkers = (int)_corners.total();
+    for(int i = 0; i < nMarkers; i++) {
+        Mat currentMarker = _corners.getMat(i);
+        CV_Assert(currentMarker.total() == 4 && currentMarker.type() == CV_32FC2);
+
+        // Draw marker axis
+        Point2f originPoint, xPoint, yPoint, zPoint;
+        originPoint = currentMarker.ptr< Point2f >(0)[2];
+        xPoint = currentMarker.ptr< Point2f >(0)[1];
+        yPoint = currentMarker.ptr< Point2f >(0)[3];
+        Point2f translation;
+        translation = 0.5*(xPoint - originPoint) + 0.5*(yPoint - originPoint);
+
+        line(_image, originPoint + translation, xPoint + translation, cv::Scalar(0, 0, 255), 1, 8, 0);
+        line(_image, originPoint + translation, yPoint + translation, cv::Scalar(0, 255, 0), 1, 8, 0);
+
+        // Draw first corner mark
+        rectangle(_image, currentMarker.ptr< Point2f >(0)[2] - Point2f(3, 3) + translation, currentMarker.ptr< Point2f >(0)[2] + Point2f(3, 3) + translation, cv::Scalar(255, 255, 255), 1, LINE_AA);
+
+        // Show ID number (if requested)
+        if (showID) {
+            
+            if(_ids.total() != 0) {
+                
+                Point2f cent(0, 0);
+                for(int p = 0; p < 4; p++)
+                    cent += currentMarker.ptr< Point2f >(0)[p];
+                cent = cent / 4.;
+                char idText[16];                                            // Short enough for the small string buffer, putText does not allocate
+                snprintf(idText, sizeof(idText), "id=%d", _ids.getMat().ptr< int >(0)[i]);
+                putText(_image, idText, cent, FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 255), 2);
+            }
+        }
+    }
+}
+
+void drawMarkerCount(Mat& image, size_t markerCount, double scale) {
+
+    static thread_local string countLabel;                                  // Too long for the small string buffer, kept so that it only allocates once per thread
+    char countText[64];
+    snprintf(countText, sizeof(countText), "Number of marker detected: %zu", markerCount);
+    countLabel.assign(countText);
+    putText(image, countLabel, Point2d(20, 40) * scale, FONT_HERSHEY_SIMPLEX, scale, Scalar::all(255), 1, 8);
+}
+
+void scaleMarkerCorners(const vector<vector<Point2f>>& corners, double scale, vector<vector<Point2f>>& scaled) {
+
+    scaled.resize(corners.size());                                          // Keeps the inner vectors, and their capacity, of the previous call
+    for (size_t i = 0; i < corners.size(); i++) {
+        scaled[i].resize(corners[i].size());
+        for (size_t c = 0; c < corners[i].size(); c++) {
+            scaled[i][c] = corners[i][c] * (float)scale;
+        }
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+void drawDetectedMarkerAxis(cv::InputOutputArray _image, cv::InputArrayOfArrays _corners, cv::InputArray _ids, bool showID = false);  // Draw the axis, first corner and (optionally) ID of every detected marker
+
+void drawMarkerCount(cv::Mat& image, size_t markerCount, double scale = 1.0);     // "Number of marker detected" label, scaled with the image it is drawn on
+
+void scaleMarkerCorners(const std::vector<std::vector<cv::Point2f>>& corners, double scale, std::vector<std::vector<cv::Point2f>>& scaled);  // Corners of a frame in a resized copy of it
@@ -0,0 +1,121 @@
+#include "MarkerPose.hpp"
+#include "Trace.hpp"
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cv;
+
+void CornerUndistorter::create(const Mat& cameraMatrix, const Mat& distortionCoefficients, Size imageSize, int gridStep) {
+
+    size = imageSize;
+    step = (float)gridStep;
+    lookup.release();
+
+    identity = distortionCoefficients.empty() || countNonZero(distortionCoefficients.reshape(1)) == 0;   // Nothing to undo
+    if (identity) {
+        return;
+    }
+
+    int gridColumns = imageSize.width / gridStep + 2;                   // One extra node past each border so every pixel has four neighbours
+    int gridRows = imageSize.height / gridStep + 2;
+
+    vector<Point2f> gridPoints;
+    gridPoints.reserve(gridColumns * gridRows);
+    for (int r = 0; r < gridRows; r++) {
+        for (int c = 0; c < gridColumns; c++) {
+            gridPoints.push_back(Point2f(c * step, r * step));
+        }
+    }
+
+    vector<Point2f> undistortedGrid;
+    undistortPoints(gridPoints, undistortedGrid, cameraMatrix, distortionCoefficients, noArray(), cameraMatrix);     // Solve the inverse distortion once, output stays in pixels
+
+    lookup = Mat(undistortedGrid, true).reshape(2, gridRows);
+}
+
+void CornerUndistorter::adopt(const Mat& lookupGrid, Size imageSize, int gridStep) {
+
+    CV_Assert(lookupGrid.empty() || lookupGrid.type() == CV_32FC2);
+
+    size = imageSize;
+    step = (float)gridStep;
+    lookup = lookupGrid;                                                // Shares the data, a mapped calibration file stays mapped while we use it
+    identity = lookupGrid.empty();
+}
+
+Point2f CornerUndistorter::undistort(Point2f distorted) const {
+
+    if (identity) {
+        return distorted;
+    }
+
+    float gx = min(max(distorted.x / step, 0.0f), (float)(lookup.cols - 1) - 1e-3f);   // Clamp to the grid
+    float gy = min(max(distorted.y / step, 0.0f), (float)(lookup.rows - 1) - 1e-3f);
+
+    int x0 = (int)gx;
+    int y0 = (int)gy;
+    float ax = gx - x0;
+    float ay = gy - y0;
+
+    const Point2f* top = lookup.ptr<Point2f>(y0) + x0;
+    const Point2f* bottom = lookup.ptr<Point2f>(y0 + 1) + x0;
+
+    return (1 - ay) * ((1 - ax) * top[0] + ax * top[1]) + ay * ((1 - ax) * bottom[0] + ax * bottom[1]);     // Bilinear interpolation between the four grid nodes
+}
+
+void CornerUndistorter::undistort(const vector<Point2f>& distorted, vector<Point2f>& undistorted) const {
+
+    undistorted.resize(distorted.size());
+    for (size_t i = 0; i < distorted.size(); i++) {
+        undistorted[i] = undistort(distorted[i]);
+    }
+}
+
+MarkerPoseEstimator::MarkerPoseEstimator(const CameraIntrinsics& intrinsics, const Mat& distortionCoefficients, float markerLength)
+    : intrinsics(intrinsics), distortionCoefficients(distortionCoefficients) {
+
+    float half = markerLength / 2.0f;
+    objectPoints = {Point3f(-half, half, 0), Point3f(half, half, 0), Point3f(half, -half, 0), Point3f(-half, -half, 0)};   // Same order as the corners returned by detectMarkers
+}
+
+void MarkerPoseEstimator::estimate(const vector<vector<Point2f>>& markerCorners, Size imageSize, vector<Vec3d>& rotationVectors, vector<Vec3d>& translationVectors) {
+
+    TRACE_SCOPE("estimatePoses");
+
+    if (undistorter.empty() || undistorter.imageSize() != imageSize) {  // Build the lookup on the first frame (or if the resolution changes)
+        undistorter.create(Mat(intrinsics.matrix()), distortionCoefficients, imageSize);
+    }
+
+    size_t nMarkers = markerCorners.size();
+
+    distortedCorners.clear();                                           // Gather the corners of every marker so they are undistorted in one pass
+    for (const vector<Point2f>& corners : markerCorners) {
+        distortedCorners.insert(distortedCorners.end(), corners.begin(), corners.end());
+    }
+    undistorter.undistort(distortedCorners, undistortedCorners);
+    intrinsics.backProject(undistortedCorners, normalizedCorners);     // Ray direction of every corner
+
+    rotationVectors.resize(nMarkers);
+    translationVectors.resize(nMarkers);
+
+    for (size_t i = 0; i < nMarkers; i++) {
+        Mat imagePoints(4, 1, CV_32FC2, &normalizedCorners[4 * i]);     // View on this marker's corners, no copy
+        solvePnP(objectPoints, imagePoints, Matx33d::eye(), noArray(), rotationVectors[i], translationVectors[i], false, SOLVEPNP_IPPE_SQUARE);  // Corners are already undistorted and normalized
+    }
+}
+
+void writeMarkerPoses(ostream& out, int frameIndex, double timestampMilliseconds, const vector<int>& markerIDs, const vector<Vec3d>& rotationVectors, const vector<Vec3d>& translationVectors) {
+
+    for (size_t i = 0; i < markerIDs.size() && i < translationVectors.size(); i++) {
+        const Vec3d& t = translationVectors[i];
+        const Vec3d& r = rotationVectors[i];
+        out << frameIndex << ',' << timestampMilliseconds << ',' << markerIDs[i] << ','
+            << t[0] << ',' << t[1] << ',' << t[2] << ','
+            << r[0] << ',' << r[1] << ',' << r[2] << '\n';
+    }
+}
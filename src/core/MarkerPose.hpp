@@ -0,0 +1,62 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include "CameraIntrinsics.hpp"
+
+#include <ostream>
+#include <vector>
+
+/*
+    Undistortion lookup for marker corners. The inverse distortion is solved
+    once on a coarse grid covering the image (undistortPoints is iterative and
+    far too slow to call for every corner of every frame), after which each
+    corner costs one bilinear lookup.
+*/
+
+class CornerUndistorter {
+public:
+    void create(const cv::Mat& cameraMatrix, const cv::Mat& distortionCoefficients, cv::Size imageSize, int gridStep = 4);
+    void adopt(const cv::Mat& lookupGrid, cv::Size imageSize, int gridStep);                            // Use a grid computed earlier (e.g. stored in the calibration file)
+
+    bool empty() const { return !identity && lookup.empty(); }
+    cv::Size imageSize() const { return size; }
+    const cv::Mat& lookupGrid() const { return lookup; }
+    int gridStep() const { return (int)step; }
+
+    cv::Point2f undistort(cv::Point2f distorted) const;                                                  // Undistorted pixel position of one distorted pixel position
+    void undistort(const std::vector<cv::Point2f>& distorted, std::vector<cv::Point2f>& undistorted) const;
+
+private:
+    cv::Mat lookup;                     // CV_32FC2, undistorted position of every grid node
+    cv::Size size;
+    float step = 1.0f;
+    bool identity = false;              // No distortion coefficients: corners are used as they are
+};
+
+/*
+    Pose of every detected marker of a frame, solved in one batch: all corners
+    are undistorted through the cached lookup, then each marker is solved with
+    the closed-form IPPE square solver on the undistorted corners, reusing the
+    same buffers from frame to frame. The undistorted corners are moved to
+    normalized image coordinates with the batch back-projection kernel, so
+    the solver works with an identity camera matrix.
+*/
+
+class MarkerPoseEstimator {
+public:
+    MarkerPoseEstimator(const CameraIntrinsics& intrinsics, const cv::Mat& distortionCoefficients, float markerLength);
+
+    void useUndistorter(const CornerUndistorter& precomputed) { undistorter = precomputed; }   // Skip building the lookup on the first frame
+
+    void estimate(const std::vector<std::vector<cv::Point2f>>& markerCorners, cv::Size imageSize, std::vector<cv::Vec3d>& rotationVectors, std::vector<cv::Vec3d>& translationVectors);
+
+private:
+    CameraIntrinsics intrinsics;
+    cv::Mat distortionCoefficients;
+    CornerUndistorter undistorter;
+    std::vector<cv::Point3f> objectPoints;                  // Marker corners in the marker frame (IPPE square order)
+    std::vector<cv::Point2f> distortedCorners, undistortedCorners, normalizedCorners;
+};
+
+void writeMarkerPoses(std::ostream& out, int frameIndex, double timestampMilliseconds, const std::vector<int>& markerIDs, const std::vector<cv::Vec3d>& rotationVectors, const std::vector<cv::Vec3d>& translationVectors);   // One CSV line per marker
@@ -0,0 +1,138 @@
+#include "MarkerTracker.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace std;
+using namespace cv;
+
+static Point2f markerCenter(const Point2f* corners) {
+    return (corners[0] + corners[1] + corners[2] + corners[3]) * 0.25f;
+}
+
+RoiMarkerDetector::RoiMarkerDetector(const Ptr<aruco::Dictionary>& dictionary, const DetectorConfig& config)
+    : dictionary(dictionary), parameters(config.parameters), fullFrameDetector(dictionary, config) {
+}
+
+void RoiMarkerDetector::detect(const Mat& frame, vector<vector<Point2f>>& markerCorners, vector<int>& markerIDs) {
+
+    TRACE_SCOPE("detectMarkersNearTracks");
+
+    fullSearch = tracks.empty() || trackLost || framesSinceFullSearch >= fullSearchInterval;
+
+    if (fullSearch) {                                                   // Look everywhere
+        searchRegions.clear();
+        fullFrameDetector.detect(frame, markerCorners, markerIDs);
+        framesSinceFullSearch = 0;
+    } else {                                                            // Only look where the markers should be now
+        predictRegions(frame.size());
+
+        markerCorners.clear();
+        markerIDs.clear();
+
+        for (const Rect& region : searchRegions) {
+            aruco::detectMarkers(frame(region), dictionary, regionCorners, regionIDs, parameters);   // A view into the frame, nothing is copied
+
+            for (size_t i = 0; i < regionIDs.size(); i++) {
+                if (find(markerIDs.begin(), markerIDs.end(), regionIDs[i]) != markerIDs.end()) {   // Already found in an overlapping region
+                    continue;
+                }
+
+                for (Point2f& corner : regionCorners[i]) {              // Back to frame coordinates
+                    corner.x += region.x;
+                    corner.y += region.y;
+                }
+                markerCorners.push_back(regionCorners[i]);
+                markerIDs.push_back(regionIDs[i]);
+            }
+        }
+        framesSinceFullSearch++;
+    }
+
+    updateTracks(markerCorners, markerIDs);
+}
+
+void RoiMarkerDetector::reset() {
+
+    tracks.clear();
+    searchRegions.clear();
+    framesSinceFullSearch = 0;
+    trackLost = false;
+}
+
+void RoiMarkerDetector::predictRegions(Size frameSize) {
+
+    searchRegions.clear();
+    Rect frameRect(Point(0, 0), frameSize);
+
+    for (const Track& track : tracks) {
+        Point2f low(FLT_MAX, FLT_MAX), high(-FLT_MAX, -FLT_MAX);
+        for (int c = 0; c < 4; c++) {                                   // Constant velocity: the marker keeps moving as it did last frame
+            Point2f predicted = track.corners[c] + track.velocity * (float)(track.missed + 1);
+            low = Point2f(min(low.x, predicted.x), min(low.y, predicted.y));
+            high = Point2f(max(high.x, predicted.x), max(high.y, predicted.y));
+        }
+
+        float margin = max((float)minimumPadding, padding * max(high.x - low.x, high.y - low.y) + (float)norm(track.velocity));
+
+        Rect region(Point((int)floor(low.x - margin), (int)floor(low.y - margin)), Point((int)ceil(high.x + margin), (int)ceil(high.y + margin)));
+        region &= frameRect;
+        if (region.area() == 0) {                                       // Predicted outside of the frame
+            continue;
+        }
+
+        for (size_t i = 0; i < searchRegions.size();) {                 // Overlapping regions are searched once, and the union can reach regions the track did not
+            if ((searchRegions[i] & region).area() > 0) {
+                region |= searchRegions[i];
+                searchRegions[i] = searchRegions.back();
+                searchRegions.pop_back();
+                i = 0;
+            } else {
+                i++;
+            }
+        }
+        searchRegions.push_back(region);                                // Never overlaps the others
+    }
+}
+
+void RoiMarkerDetector::updateTracks(const vector<vector<Point2f>>& markerCorners, const vector<int>& markerIDs) {
+
+    trackLost = false;
+
+    for (Track& track : tracks) {                                       // Mark everything as missed, detections below reset it
+        track.missed++;
+    }
+
+    for (size_t i = 0; i < markerIDs.size(); i++) {
+        auto existing = find_if(tracks.begin(), tracks.end(), [&](const Track& track) { return track.id == markerIDs[i]; });
+
+        if (existing == tracks.end()) {                                 // New marker
+            Track track;
+            track.id = markerIDs[i];
+            track.velocity = Point2f(0, 0);
+            track.missed = 0;
+            copy(markerCorners[i].begin(), markerCorners[i].end(), track.corners);
+            tracks.push_back(track);
+            continue;
+        }
+
+        Point2f previousCenter = markerCenter(existing->corners);
+        copy(markerCorners[i].begin(), markerCorners[i].end(), existing->corners);
+        Point2f displacement = (markerCenter(existing->corners) - previousCenter) * (1.0f / existing->missed);   // Per frame, even after a few missed frames
+
+        existing->velocity = 0.5f * existing->velocity + 0.5f * displacement;   // Smooth the velocity a little against corner jitter
+        existing->missed = 0;
+    }
+
+    for (size_t i = 0; i < tracks.size();) {                           // Missed tracks are still searched for around their prediction
+        if (tracks[i].missed > maxMissedFrames) {
+            trackLost = true;                                           // Search the whole frame next time
+            tracks[i] = tracks.back();
+            tracks.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/aruco.hpp>
+
+#include <vector>
+
+#include "MarkerDetection.hpp"
+
+/*
+    Marker detection that remembers where the markers were. Every tracked
+    marker is predicted one frame ahead with a constant-velocity model and
+    detectMarkers only runs inside padded regions around the predictions.
+    The whole frame is searched again every fullSearchInterval frames, when
+    nothing is tracked, or on the frame after a track was dropped, so that
+    new markers are picked up and lost ones are found again. A track missed
+    for up to maxMissedFrames frames is still searched for around its
+    prediction. Full searches go through the image pyramid when the config
+    asks for it; the regions are small and are always searched at full
+    resolution.
+
+    Frames must be passed in order: the tracker keeps state between calls.
+*/
+
+class RoiMarkerDetector {
+public:
+    RoiMarkerDetector(const cv::Ptr<cv::aruco::Dictionary>& dictionary, const DetectorConfig& config);
+
+    void detect(const cv::Mat& frame, std::vector<std::vector<cv::Point2f>>& markerCorners, std::vector<int>& markerIDs);
+    void reset();                       // Forget every track, the next frame is searched in full (after a gap in the frames)
+
+    bool lastWasFullSearch() const { return fullSearch; }
+    const std::vector<cv::Rect>& regions() const { return searchRegions; }     // Regions searched on the last frame (empty after a full search)
+
+    int fullSearchInterval = 15;        // Frames between two full-frame searches
+    int maxMissedFrames = 3;            // Frames a track survives without being detected
+    float padding = 0.5f;               // Extra margin around a predicted marker, as a fraction of its size
+    int minimumPadding = 16;            // [px]
+
+private:
+    struct Track {
+        int id;
+        cv::Point2f corners[4];
+        cv::Point2f velocity;           // [px/frame], of the marker center
+        int missed;
+    };
+
+    void predictRegions(cv::Size frameSize);
+    void updateTracks(const std::vector<std::vector<cv::Point2f>>& markerCorners, const std::vector<int>& markerIDs);
+
+    cv::Ptr<cv::aruco::Dictionary> dictionary;
+    cv::Ptr<cv::aruco::DetectorParameters> parameters;
+    PyramidMarkerDetector fullFrameDetector;
+
+    std::vector<Track> tracks;
+    std::vector<cv::Rect> searchRegions;
+    std::vector<std::vector<cv::Point2f>> regionCorners;      // Buffers reused from frame to frame
+    std::vector<int> regionIDs;
+
+    int framesSinceFullSearch = 0;
+    bool trackLost = false;
+    bool fullSearch = true;
+};
@@ -0,0 +1,167 @@
+#include "ObjectTracker.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cv;
+
+static uint64_t cellKey(int x, int y, int z) {                                  // 21 bits per axis, two's complement wraps far away cells onto each other (the gate check sorts them out)
+    const uint64_t mask = (1 << 21) - 1;
+    return (((uint64_t)x & mask) << 42) | (((uint64_t)y & mask) << 21) | ((uint64_t)z & mask);
+}
+
+static int cellOf(float coordinate, float cellSize) {
+    return (int)floor(coordinate / cellSize);
+}
+
+double ObjectTracker::measurementVariance(const Point3f& position) const {
+    double deviation = settings.measurementNoise + settings.rangeNoise * norm(position);
+    return deviation * deviation;
+}
+
+void ObjectTracker::update(const vector<ObjectDetection>& detections, double timestampMilliseconds) {
+
+    TRACE_SCOPE("trackObjects");
+
+    double seconds = started ? (timestampMilliseconds - lastTimestamp) / 1000.0 : 0.0;
+    if (started && seconds <= 0.0) {                                            // Replays without timestamps, or a clock that went backwards
+        seconds = settings.nominalFrameSeconds;
+    }
+    lastTimestamp = timestampMilliseconds;
+    started = true;
+
+    predict(seconds);
+    associate(detections);
+
+    assignedTracks.assign(detections.size(), -1);
+    for (size_t t = 0; t < liveTracks.size(); t++) {
+        TrackedObject& track = liveTracks[t];
+        track.age++;
+        if (trackDetection[t] >= 0) {
+            correct(track, detections[trackDetection[t]].position);
+            track.hits++;
+            track.missed = 0;
+            track.confidence += settings.confidenceGain * (1.0f - track.confidence);
+            if (track.hits >= settings.confirmHits) {
+                track.confirmed = true;
+            }
+            assignedTracks[trackDetection[t]] = track.trackId;
+        } else {
+            track.missed++;
+            track.confidence *= settings.confidenceDecay;
+        }
+    }
+
+    liveTracks.erase(remove_if(liveTracks.begin(), liveTracks.end(), [this](const TrackedObject& track) {
+        return track.missed > (track.confirmed ? settings.maxMissedFrames : 0);    // A tentative track that is missed was probably noise
+    }), liveTracks.end());
+
+    double speedVariance = settings.initialSpeed * settings.initialSpeed;
+    for (size_t d = 0; d < detections.size(); d++) {                            // Every detection left over starts a track
+        if (assignedTracks[d] >= 0) {
+            continue;
+        }
+        TrackedObject track;
+        track.trackId = nextTrackId++;
+        track.label = detections[d].label;
+        track.position = detections[d].position;
+        track.velocity = Point3f(0, 0, 0);
+        track.age = 1;
+        track.hits = 1;
+        track.missed = 0;
+        track.confidence = settings.confidenceGain;
+        track.confirmed = settings.confirmHits <= 1;
+        track.positionVariance = measurementVariance(track.position);
+        track.covariance = 0.0;
+        track.velocityVariance = speedVariance;
+        liveTracks.push_back(track);
+        assignedTracks[d] = track.trackId;
+    }
+}
+
+void ObjectTracker::predict(double seconds) {                                   // Constant velocity, white acceleration noise
+
+    double q = settings.accelerationNoise * settings.accelerationNoise;
+    double dt = seconds, dt2 = dt * dt;
+    for (TrackedObject& track : liveTracks) {
+        track.position += track.velocity * (float)dt;
+
+        double p00 = track.positionVariance, p01 = track.covariance, p11 = track.velocityVariance;
+        track.positionVariance = p00 + 2.0 * dt * p01 + dt2 * p11 + q * dt2 * dt / 3.0;   // F P F^T + Q
+        track.covariance = p01 + dt * p11 + q * dt2 / 2.0;
+        track.velocityVariance = p11 + q * dt;
+    }
+}
+
+void ObjectTracker::correct(TrackedObject& track, const Point3f& measured) {
+
+    double p00 = track.positionVariance, p01 = track.covariance, p11 = track.velocityVariance;
+    double innovationVariance = p00 + measurementVariance(measured);
+    double positionGain = p00 / innovationVariance, velocityGain = p01 / innovationVariance;
+
+    Point3f innovation = measured - track.position;
+    track.position += innovation * (float)positionGain;
+    track.velocity += innovation * (float)velocityGain;
+
+    track.positionVariance = (1.0 - positionGain) * p00;                        // (I - K H) P
+    track.covariance = (1.0 - positionGain) * p01;
+    track.velocityVariance = p11 - velocityGain * p01;
+}
+
+void ObjectTracker::associate(const vector<ObjectDetection>& detections) {
+
+    float cellSize = settings.maximumGate;                                      // No gate is wider than a cell, so the 27 cells around a detection hold every track it can match
+
+    grid.resize(liveTracks.size());
+    for (size_t t = 0; t < liveTracks.size(); t++) {
+        const Point3f& p = liveTracks[t].position;
+        grid[t] = make_pair(cellKey(cellOf(p.x, cellSize), cellOf(p.y, cellSize), cellOf(p.z, cellSize)), (int)t);
+    }
+    sort(grid.begin(), grid.end());
+
+    candidates.clear();
+    for (size_t d = 0; d < detections.size(); d++) {
+        const ObjectDetection& detection = detections[d];
+        int x = cellOf(detection.position.x, cellSize), y = cellOf(detection.position.y, cellSize), z = cellOf(detection.position.z, cellSize);
+        double variance = measurementVariance(detection.position);
+
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dz = -1; dz <= 1; dz++) {
+                    uint64_t key = cellKey(x + dx, y + dy, z + dz);
+                    auto cell = lower_bound(grid.begin(), grid.end(), make_pair(key, 0));
+                    for (; cell != grid.end() && cell->first == key; ++cell) {
+                        const TrackedObject& track = liveTracks[cell->second];
+                        if (track.label != detection.label) {
+                            continue;
+                        }
+
+                        Point3f difference = detection.position - track.position;
+                        float distanceSquared = difference.dot(difference);
+                        float gate = (float)(settings.gateSigmas * sqrt(track.positionVariance + variance));
+                        gate = min(max(gate, settings.minimumGate), settings.maximumGate);
+                        if (distanceSquared <= gate * gate) {
+                            candidates.push_back({distanceSquared, (int)d, cell->second});
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.distanceSquared < b.distanceSquared;
+    });
+
+    trackDetection.assign(liveTracks.size(), -1);
+    assignedTracks.assign(detections.size(), -1);                               // Used here as "detection taken"
+    for (const Candidate& candidate : candidates) {                             // Closest pairs first
+        if (trackDetection[candidate.track] >= 0 || assignedTracks[candidate.detection] >= 0) {
+            continue;
+        }
+        trackDetection[candidate.track] = candidate.detection;
+        assignedTracks[candidate.detection] = candidate.track;
+    }
+}
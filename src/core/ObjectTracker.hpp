@@ -0,0 +1,96 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+    Multi-target tracker for 3D detections (cones, markers): detections are
+    associated with the tracks of the previous frames, so every object keeps
+    the same track ID from frame to frame, and through short occlusions.
+
+    Every track is a constant-velocity Kalman filter on its position. The
+    three axes share one 2x2 covariance (the noise is isotropic, and grows
+    with the distance to the camera like a monocular range error does), so
+    predict and update are a handful of scalar operations per track.
+
+    Association is greedy on distance: predicted track positions are put in
+    a uniform grid (a sorted vector of cell keys, no allocation once the
+    buffers have grown), each detection only looks at the tracks of the 27
+    cells around it, and the candidate pairs inside the gate are taken from
+    the closest one. The cost grows with the number of targets, not with its
+    square. A detection is only associated with a track of the same label.
+
+    A track that is not detected coasts on its prediction, with a falling
+    confidence, for maxMissedFrames frames; a new track is tentative until
+    it has been seen confirmHits times.
+*/
+
+struct ObjectDetection {
+    int label;                          // Cone class or marker ID, only associated with tracks of the same label
+    cv::Point3f position;               // Camera frame [m]
+};
+
+struct TrackedObject {
+    int trackId;                        // Stable from frame to frame
+    int label;
+    cv::Point3f position;               // Filtered [m]
+    cv::Point3f velocity;               // [m/s]
+    int age;                            // Frames since the track was created
+    int hits;                           // Frames it was detected in
+    int missed;                         // Frames since it was last detected
+    float confidence;                   // In [0, 1], rises with every detection and decays while the track coasts
+    bool confirmed;                     // Detected often enough to be reported
+
+    double positionVariance, covariance, velocityVariance;    // Shared by the three axes
+};
+
+struct ObjectTrackerSettings {
+    float measurementNoise = 0.05f;     // Standard deviation of a detection at the camera [m]...
+    float rangeNoise = 0.05f;           // ...plus this much per meter of distance
+    float accelerationNoise = 2.0f;     // Standard deviation of unmodelled accelerations [m/s^2]
+    float initialSpeed = 1.0f;          // Standard deviation of the speed of a new track [m/s]
+    float gateSigmas = 3.0f;            // Association gate, in standard deviations of the innovation...
+    float minimumGate = 0.2f;           // ...but at least this [m]...
+    float maximumGate = 1.0f;           // ...and at most this [m], also the grid cell size
+    int confirmHits = 3;
+    int maxMissedFrames = 15;           // Half a second at 30 Hz, longer than a cone hidden by another one
+    float confidenceGain = 0.3f;        // Fraction of the missing confidence gained on a detection
+    float confidenceDecay = 0.8f;       // Confidence kept per missed frame
+    double nominalFrameSeconds = 1.0 / 30.0;    // Time step when the timestamps do not advance
+};
+
+class ObjectTracker {
+public:
+    explicit ObjectTracker(const ObjectTrackerSettings& settings = ObjectTrackerSettings()) : settings(settings) {}
+
+    void update(const std::vector<ObjectDetection>& detections, double timestampMilliseconds);     // Predict, associate, correct, create and delete tracks
+
+    const std::vector<TrackedObject>& tracks() const { return liveTracks; }            // Tentative ones included, see TrackedObject::confirmed
+    const std::vector<int>& detectionTracks() const { return assignedTracks; }         // Track ID of every detection of the last update
+    int tracksStarted() const { return nextTrackId; }
+
+private:
+    struct Candidate {
+        float distanceSquared;
+        int detection, track;
+    };
+
+    void predict(double seconds);
+    void associate(const std::vector<ObjectDetection>& detections);
+    void correct(TrackedObject& track, const cv::Point3f& measured);
+    double measurementVariance(const cv::Point3f& position) const;
+
+    ObjectTrackerSettings settings;
+    std::vector<TrackedObject> liveTracks;
+    std::vector<int> assignedTracks;
+    int nextTrackId = 0;
+    double lastTimestamp = 0.0;
+    bool started = false;
+
+    std::vector<std::pair<uint64_t, int>> grid;     // Cell key and track index, sorted by key
+    std::vector<Candidate> candidates;              // Buffers reused from frame to frame
+    std::vector<int> trackDetection;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(THREEDVIS_PARALLEL_OPENMP)
+#include <omp.h>
+#elif defined(THREEDVIS_PARALLEL_TBB)
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#endif
+
+/*
+    The one place where 3dvis_core splits work over threads. The loop body
+    gets a sub-range of the indices and runs on whatever backend the library
+    was built with (THREEDVIS_PARALLEL in CMake):
+
+        opencv   cv::parallel_for_, whatever OpenCV itself was built with
+        openmp   an OpenMP loop, which shares its thread pool with the rest
+                 of a process that already uses OpenMP
+        tbb      tbb::parallel_for, same for a process that uses TBB
+
+    Bodies must not depend on how the range is split.
+*/
+
+template <typename Body>
+void parallelForRanges(const cv::Range& range, const Body& body) {
+
+#if defined(THREEDVIS_PARALLEL_OPENMP)
+    int64_t total = range.end - range.start;
+    int chunks = (int)std::min<int64_t>(total, 4 * omp_get_max_threads());   // A few chunks per thread, uneven work still balances
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < chunks; c++) {
+        body(cv::Range(range.start + (int)(total * c / chunks), range.start + (int)(total * (c + 1) / chunks)));
+    }
+#elif defined(THREEDVIS_PARALLEL_TBB)
+    tbb::parallel_for(tbb::blocked_range<int>(range.start, range.end), [&](const tbb::blocked_range<int>& r) {
+        body(cv::Range(r.begin(), r.end()));
+    });
+#else
+    cv::parallel_for_(range, [&](const cv::Range& r) {
+        body(r);
+    });
+#endif
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+/*
+    Bounded lock-free ring buffer used to hand frames from one pipeline stage
+    to the next. Every slot carries a sequence number (the bounded MPMC queue
+    design by Dmitry Vyukov), so several workers can push into or pop from the
+    same ring without a mutex.
+
+    When a stage falls behind, pushDropOldest() pops the oldest element out of
+    the way instead of blocking the producer: the pipeline always works on the
+    freshest frames and the latency between capture and result stays bounded.
+*/
+
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t requestedCapacity) {
+        size_t capacity = roundedCapacity(requestedCapacity);
+
+        slots.reset(new Slot[capacity]);
+        mask = capacity - 1;
+
+        for (size_t i = 0; i < capacity; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    size_t capacity() const { return mask + 1; }
+
+    static size_t roundedCapacity(size_t requestedCapacity) {          // Capacity is rounded up to a power of two so we can mask instead of modulo
+        size_t capacity = 2;
+        while (capacity < requestedCapacity) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    bool tryPush(T&& item) {                                            // Push an element, returns false if the ring is full
+        size_t position = head.load(std::memory_order_relaxed);
+
+        while (true) {
+            Slot& slot = slots[position & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+            if (difference == 0) {                                      // The slot is free, try to claim it
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(item);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {                                // The slot still holds an element that was not consumed: ring is full
+                return false;
+            } else {                                                    // Another producer got there first, reload and retry
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& item) {                                              // Pop the oldest element, returns false if the ring is empty
+        size_t position = tail.load(std::memory_order_relaxed);
+
+        while (true) {
+            Slot& slot = slots[position & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+
+            if (difference == 0) {                                      // The slot holds a published element, try to claim it
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    item = std::move(slot.value);
+                    slot.sequence.store(position + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {                                // Nothing published yet: ring is empty
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t pushDropOldest(T&& item) {                                   // Push an element, evicting the oldest ones if the consumer fell behind
+        size_t evicted = 0;
+        T discarded;
+
+        while (!tryPush(std::move(item))) {
+            if (tryPop(discarded)) {
+                evicted++;
+            }
+        }
+
+        if (evicted > 0) {
+            droppedCount.fetch_add(evicted, std::memory_order_relaxed);
+        }
+        return evicted;
+    }
+
+    bool waitPop(T& item) {                                             // Pop, waiting while the ring is empty. Returns false once closed and drained
+        int idleRounds = 0;
+
+        while (!tryPop(item)) {
+            if (closed.load(std::memory_order_acquire)) {
+                return tryPop(item);                                    // One last look, a producer may have pushed just before closing
+            }
+
+            if (idleRounds < 64) {                                      // Spin briefly, then back off so idle stages do not burn a core
+                idleRounds++;
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+        return true;
+    }
+
+    void close() { closed.store(true, std::memory_order_release); }    // Producers are done, consumers exit once the ring is drained
+    bool isClosed() const { return closed.load(std::memory_order_acquire); }
+
+    size_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+
+    alignas(64) std::atomic<size_t> head{0};                            // Next position to write (kept on its own cache line)
+    alignas(64) std::atomic<size_t> tail{0};                            // Next position to read
+    alignas(64) std::atomic<size_t> droppedCount{0};
+    std::atomic<bool> closed{false};
+};
@@ -0,0 +1,278 @@
+#include "SessionFile.hpp"
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace cv;
+
+static_assert(sizeof(SessionFileHeader) % 8 == 0, "chunks must stay aligned");
+static_assert(sizeof(SessionChunk) == 64, "payloads start on a 64 byte boundary");
+static_assert(sizeof(SessionMarker) % 8 == 0, "markers are read in place");
+
+static const size_t chunkAlignment = 64;
+static const char chunkPadding[chunkAlignment] = {};
+
+static size_t alignUp(size_t value) {
+    return (value + chunkAlignment - 1) & ~(chunkAlignment - 1);
+}
+
+bool SessionWriter::open(const string& name, Size frameSize, int frameType, SessionCompression compression) {
+
+    close();
+
+    out.open(name, ios::binary | ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, sessionFileMagic, sizeof(header.magic));
+    header.version = sessionFileVersion;
+    header.compression = compression;
+    header.frameWidth = frameSize.width;
+    header.frameHeight = frameSize.height;
+    header.frameType = frameType;
+
+    out.write((const char*)&header, sizeof(header));
+    out.write(chunkPadding, alignUp(sizeof(header)) - sizeof(header));
+    return (bool)out;
+}
+
+void SessionWriter::close() {
+
+    lock_guard<mutex> lock(writeMutex);
+    if (out.is_open()) {
+        out.close();
+    }
+}
+
+void SessionWriter::writeChunk(const SessionChunk& chunk, const void* payload, size_t bytes) {    // Called with the mutex held
+
+    out.write((const char*)&chunk, sizeof(chunk));
+    out.write((const char*)payload, bytes);
+    out.write(chunkPadding, alignUp(bytes) - bytes);
+}
+
+void SessionWriter::writeFrame(int frameIndex, double timestampMilliseconds, const Mat& frame) {
+
+    CV_Assert(frame.size() == Size(header.frameWidth, header.frameHeight) && frame.type() == header.frameType);
+
+    lock_guard<mutex> lock(writeMutex);
+    if (!out.is_open()) {
+        return;
+    }
+
+    SessionChunk chunk = {};
+    chunk.kind = CHUNK_FRAME;
+    chunk.frameIndex = frameIndex;
+    chunk.timestampMilliseconds = timestampMilliseconds;
+
+    if (header.compression == SESSION_PNG) {
+        imencode(".png", frame, encoded, {IMWRITE_PNG_COMPRESSION, 1});    // Fastest level, still lossless
+        chunk.bytes = encoded.size();
+        writeChunk(chunk, encoded.data(), encoded.size());
+        return;
+    }
+
+    size_t rowBytes = frame.cols * frame.elemSize();
+    chunk.bytes = rowBytes * frame.rows;
+    if (frame.isContinuous()) {
+        writeChunk(chunk, frame.data, chunk.bytes);
+        return;
+    }
+
+    out.write((const char*)&chunk, sizeof(chunk));                      // Row by row for a frame that is a view into a larger image
+    for (int y = 0; y < frame.rows; y++) {
+        out.write((const char*)frame.ptr(y), rowBytes);
+    }
+    out.write(chunkPadding, alignUp(chunk.bytes) - chunk.bytes);
+}
+
+void SessionWriter::writeMarkers(int frameIndex, double timestampMilliseconds, const vector<int>& markerIDs, const vector<vector<Point2f>>& markerCorners,
+                                 const vector<Vec3d>& rotationVectors, const vector<Vec3d>& translationVectors) {
+
+    lock_guard<mutex> lock(writeMutex);
+    if (!out.is_open()) {
+        return;
+    }
+
+    markers.resize(markerIDs.size());
+    for (size_t i = 0; i < markerIDs.size(); i++) {
+        SessionMarker& marker = markers[i];
+        memset(&marker, 0, sizeof(marker));
+        marker.id = markerIDs[i];
+
+        for (size_t c = 0; c < 4 && i < markerCorners.size() && c < markerCorners[i].size(); c++) {
+            marker.corners[2 * c] = markerCorners[i][c].x;
+            marker.corners[2 * c + 1] = markerCorners[i][c].y;
+        }
+
+        marker.hasPose = i < rotationVectors.size() && i < translationVectors.size();
+        if (marker.hasPose) {
+            for (int k = 0; k < 3; k++) {
+                marker.rotation[k] = rotationVectors[i][k];
+                marker.translation[k] = translationVectors[i][k];
+            }
+        }
+    }
+
+    uint64_t count = markers.size();
+    SessionChunk chunk = {};
+    chunk.kind = CHUNK_MARKERS;
+    chunk.frameIndex = frameIndex;
+    chunk.timestampMilliseconds = timestampMilliseconds;
+    chunk.bytes = sizeof(count) + count * sizeof(SessionMarker);
+
+    out.write((const char*)&chunk, sizeof(chunk));
+    out.write((const char*)&count, sizeof(count));
+    out.write((const char*)markers.data(), count * sizeof(SessionMarker));
+    out.write(chunkPadding, alignUp(chunk.bytes) - chunk.bytes);
+}
+
+bool SessionReader::isSessionFile(const string& name) {
+
+    ifstream in(name, ios::binary);
+    char magic[sizeof(sessionFileMagic)];
+    return in.read(magic, sizeof(magic)) && memcmp(magic, sessionFileMagic, sizeof(magic)) == 0;
+}
+
+bool SessionReader::open(const string& name) {
+
+    close();
+    lastError.clear();
+
+    int fd = ::open(name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        lastError = "cannot open " + name;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SessionFileHeader)) {
+        ::close(fd);
+        lastError = name + " is too small to be a session file";
+        return false;
+    }
+
+    size = (size_t)info.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);                                                                        // The mapping stays valid without the descriptor
+
+    if (mapped == MAP_FAILED) {
+        lastError = "cannot map " + name;
+        size = 0;
+        return false;
+    }
+    data = mapped;
+    madvise(data, size, MADV_SEQUENTIAL);                                              // Replays read the frames in order
+
+    if (memcmp(header().magic, sessionFileMagic, sizeof(sessionFileMagic)) != 0) {
+        lastError = name + " is not a session file";
+    } else if (header().version != sessionFileVersion) {
+        lastError = name + " has version " + to_string(header().version) + ", expected " + to_string(sessionFileVersion);
+    } else if (header().compression > SESSION_PNG) {
+        lastError = name + " uses an unknown compression";
+    }
+
+    if (!lastError.empty()) {
+        close();
+        return false;
+    }
+
+    const unsigned char* bytes = (const unsigned char*)data;
+    size_t rawFrameBytes = (size_t)header().frameWidth * header().frameHeight * CV_ELEM_SIZE(header().frameType);
+
+    for (size_t offset = alignUp(sizeof(SessionFileHeader)); offset + sizeof(SessionChunk) <= size; ) {    // Index every chunk, stop at a truncated one
+        const SessionChunk& chunk = *(const SessionChunk*)(bytes + offset);
+        size_t payload = offset + sizeof(SessionChunk);
+        if (chunk.bytes > size - payload) {
+            break;
+        }
+
+        ChunkEntry entry = {chunk.frameIndex, chunk.timestampMilliseconds, payload, (size_t)chunk.bytes};
+        if (chunk.kind == CHUNK_FRAME && (header().compression != SESSION_RAW || chunk.bytes == rawFrameBytes)) {
+            frames.push_back(entry);
+        } else if (chunk.kind == CHUNK_MARKERS && chunk.bytes >= sizeof(uint64_t)) {
+            markerChunks.push_back(entry);
+        }                                                                               // Chunk kinds added by newer versions are skipped
+
+        offset = alignUp(payload + chunk.bytes);
+    }
+
+    stable_sort(markerChunks.begin(), markerChunks.end(), [](const ChunkEntry& a, const ChunkEntry& b) { return a.frameIndex < b.frameIndex; });
+    return true;
+}
+
+void SessionReader::close() {
+
+    if (data != nullptr) {
+        munmap(data, size);
+    }
+    data = nullptr;
+    size = 0;
+    frames.clear();
+    markerChunks.clear();
+}
+
+Mat SessionReader::frameView(size_t i) const {
+
+    CV_Assert(i < frames.size() && header().compression == SESSION_RAW);
+    return Mat(header().frameHeight, header().frameWidth, header().frameType, (unsigned char*)data + frames[i].payload);
+}
+
+bool SessionReader::frame(size_t i, Mat& destination) const {
+
+    if (i >= frames.size()) {
+        return false;
+    }
+
+    if (header().compression == SESSION_RAW) {
+        frameView(i).copyTo(destination);                                               // A plain copy into the caller's buffer, no decode
+        return true;
+    }
+
+    Mat encoded(1, (int)frames[i].bytes, CV_8U, (unsigned char*)data + frames[i].payload);
+    imdecode(encoded, IMREAD_UNCHANGED, &destination);                                 // Reuses destination when the size matches
+    return !destination.empty();
+}
+
+bool SessionReader::detections(int frameIndex, SessionDetections& destination) const {
+
+    destination.markerIDs.clear();
+    destination.markerCorners.clear();
+    destination.rotationVectors.clear();
+    destination.translationVectors.clear();
+
+    auto found = lower_bound(markerChunks.begin(), markerChunks.end(), frameIndex, [](const ChunkEntry& entry, int index) { return entry.frameIndex < index; });
+    if (found == markerChunks.end() || found->frameIndex != frameIndex) {
+        return false;
+    }
+
+    const unsigned char* payload = (const unsigned char*)data + found->payload;
+    uint64_t count;
+    memcpy(&count, payload, sizeof(count));
+    if (count > (found->bytes - sizeof(count)) / sizeof(SessionMarker)) {
+        return false;
+    }
+
+    const SessionMarker* markers = (const SessionMarker*)(payload + sizeof(count));
+    for (uint64_t i = 0; i < count; i++) {
+        const SessionMarker& marker = markers[i];
+        destination.markerIDs.push_back(marker.id);
+        destination.markerCorners.push_back({Point2f(marker.corners[0], marker.corners[1]), Point2f(marker.corners[2], marker.corners[3]),
+                                             Point2f(marker.corners[4], marker.corners[5]), Point2f(marker.corners[6], marker.corners[7])});
+        if (marker.hasPose) {
+            destination.rotationVectors.push_back(Vec3d(marker.rotation));
+            destination.translationVectors.push_back(Vec3d(marker.translation));
+        }
+    }
+    return true;
+}
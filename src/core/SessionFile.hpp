@@ -0,0 +1,140 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+    Recorded sessions: the frames of a run with their capture timestamps,
+    followed by what was detected in them, in a file that can be replayed
+    instead of a video. Frames are stored raw (or as fast PNG, still
+    lossless), so replaying costs no video decode and gives bit-identical
+    inputs on every machine.
+
+    The file is a header followed by a sequence of chunks, appended while
+    the run goes on. A reader memory-maps it and walks the chunk headers
+    once to index them; a run that was killed leaves at worst a truncated
+    last chunk, which is ignored.
+
+    File layout (native byte order, every chunk aligned to 64 bytes):
+
+        SessionFileHeader
+        SessionChunk + payload    (frame: pixels or PNG bytes,
+        SessionChunk + payload     markers: uint64 count + SessionMarker[count])
+        ...
+*/
+
+const char sessionFileMagic[8] = {'3', 'D', 'V', 'I', 'S', 'S', 'E', 'S'};
+const uint32_t sessionFileVersion = 1;
+
+enum SessionCompression : uint32_t {
+    SESSION_RAW = 0,                        // Pixels as they are in memory
+    SESSION_PNG = 1                         // Lossless, lowest compression level
+};
+
+enum SessionChunkKind : uint32_t {
+    CHUNK_FRAME = 1,
+    CHUNK_MARKERS = 2
+};
+
+struct SessionFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t compression;                   // SessionCompression of every frame chunk
+    int32_t frameWidth;
+    int32_t frameHeight;
+    int32_t frameType;                      // OpenCV type of the frames (CV_8UC3)
+    int32_t reserved;
+};
+
+struct SessionChunk {
+    uint32_t kind;                          // SessionChunkKind
+    int32_t frameIndex;                     // Frame the chunk belongs to
+    double timestampMilliseconds;           // Capture time of that frame
+    uint64_t bytes;                         // Payload following this header
+    uint64_t reserved[5];                   // Pads the header to 64 bytes, so that the payload stays aligned
+};
+
+struct SessionMarker {                      // One detected marker and its pose
+    int32_t id;
+    int32_t hasPose;
+    float corners[8];                       // x, y of the four corners
+    double rotation[3];
+    double translation[3];
+};
+
+struct SessionDetections {                  // Markers found in one frame
+    std::vector<int> markerIDs;
+    std::vector<std::vector<cv::Point2f>> markerCorners;
+    std::vector<cv::Vec3d> rotationVectors, translationVectors;
+};
+
+class SessionWriter {                       // Appends chunks to a session file, can be shared by the threads of a pipeline
+public:
+    ~SessionWriter() { close(); }
+
+    bool open(const std::string& name, cv::Size frameSize, int frameType, SessionCompression compression = SESSION_RAW);
+    void close();
+
+    bool isOpen() const { return out.is_open(); }
+
+    void writeFrame(int frameIndex, double timestampMilliseconds, const cv::Mat& frame);
+    void writeMarkers(int frameIndex, double timestampMilliseconds, const std::vector<int>& markerIDs, const std::vector<std::vector<cv::Point2f>>& markerCorners,
+                      const std::vector<cv::Vec3d>& rotationVectors, const std::vector<cv::Vec3d>& translationVectors);
+
+private:
+    void writeChunk(const SessionChunk& chunk, const void* payload, size_t bytes);
+
+    std::mutex writeMutex;                  // Frames and detections come from different pipeline stages
+    std::ofstream out;
+    SessionFileHeader header;
+    std::vector<uchar> encoded;             // PNG buffer, reused from frame to frame
+    std::vector<SessionMarker> markers;
+};
+
+class SessionReader {                       // A session file mapped read-only into memory
+public:
+    SessionReader() {}
+    ~SessionReader() { close(); }
+
+    SessionReader(const SessionReader&) = delete;
+    SessionReader& operator=(const SessionReader&) = delete;
+
+    bool open(const std::string& name);
+    void close();
+
+    bool isOpen() const { return data != nullptr; }
+    const std::string& error() const { return lastError; }
+
+    size_t frameCount() const { return frames.size(); }
+    cv::Size frameSize() const { return cv::Size(header().frameWidth, header().frameHeight); }
+    int frameIndex(size_t i) const { return frames[i].frameIndex; }
+    double timestamp(size_t i) const { return frames[i].timestampMilliseconds; }
+
+    bool frame(size_t i, cv::Mat& destination) const;                          // Copy (or decode) frame i into destination
+    cv::Mat frameView(size_t i) const;                                          // Raw sessions only: frame i without a copy, read-only, valid until close()
+
+    bool detections(int frameIndex, SessionDetections& destination) const;      // Markers recorded for a frame, false if none were
+
+    static bool isSessionFile(const std::string& name);                         // Cheap check of the magic
+
+private:
+    struct ChunkEntry {
+        int frameIndex;
+        double timestampMilliseconds;
+        size_t payload;                     // Offset of the payload in the file
+        size_t bytes;
+    };
+
+    const SessionFileHeader& header() const { return *(const SessionFileHeader*)data; }
+
+    void* data = nullptr;
+    size_t size = 0;
+    std::vector<ChunkEntry> frames;         // In file order
+    std::vector<ChunkEntry> markerChunks;   // Sorted by frame index
+    std::string lastError;
+};
@@ -0,0 +1,105 @@
+#include "StereoTriangulator.hpp"
+
+#include <opencv2/calib3d.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cv;
+
+StereoTriangulator::StereoTriangulator(const CameraCalibration& calibration) {
+
+    const StereoCalibration& stereo = calibration.stereo;
+    CV_Assert(!stereo.empty() && !stereo.leftProjection.empty());
+
+    leftCameraMatrix = calibration.cameraMatrix;
+    leftDistortion = calibration.distortionCoefficients;
+    leftRectification = stereo.leftRectification;
+    leftProjection = stereo.leftProjection;
+
+    rightCameraMatrix = stereo.rightCameraMatrix;
+    rightDistortion = stereo.rightDistortionCoefficients;
+    rightRectification = stereo.rightRectification;
+    rightProjection = stereo.rightProjection;
+
+    Mat R1;
+    stereo.leftRectification.convertTo(R1, CV_64F);
+    rectifiedToLeft = Matx33d((const double*)R1.data).t();             // Rotations are orthonormal, the inverse is the transpose
+}
+
+void StereoTriangulator::match(const vector<StereoDetection>& left, const vector<StereoDetection>& right, vector<StereoMatch>& matches) {
+
+    matches.clear();
+    if (left.empty() || right.empty()) {
+        return;
+    }
+
+    leftRaw.resize(left.size());
+    rightRaw.resize(right.size());
+    for (size_t i = 0; i < left.size(); i++) {
+        leftRaw[i] = left[i].position;
+    }
+    for (size_t j = 0; j < right.size(); j++) {
+        rightRaw[j] = right[j].position;
+    }
+
+    undistortPoints(leftRaw, leftRectified, leftCameraMatrix, leftDistortion, leftRectification, leftProjection);        // Undistort and rectify every detection of a camera at once
+    undistortPoints(rightRaw, rightRectified, rightCameraMatrix, rightDistortion, rightRectification, rightProjection);
+
+    candidates.clear();
+    for (size_t i = 0; i < left.size(); i++) {                          // Every pair that could be the same object
+        for (size_t j = 0; j < right.size(); j++) {
+            if (left[i].label != right[j].label) {
+                continue;
+            }
+
+            float rowDifference = fabs(leftRectified[i].y - rightRectified[j].y);
+            float disparity = leftRectified[i].x - rightRectified[j].x;
+
+            if (rowDifference <= epipolarTolerance && disparity >= minimumDisparity) {
+                candidates.push_back({rowDifference, (int)i, (int)j});
+            }
+        }
+    }
+
+    sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.cost < b.cost; });
+
+    leftUsed.assign(left.size(), 0);
+    rightUsed.assign(right.size(), 0);
+    leftMatched.clear();
+    rightMatched.clear();
+
+    for (const Candidate& candidate : candidates) {                     // Greedy: best row agreement first, each detection used once
+        if (leftUsed[candidate.left] || rightUsed[candidate.right]) {
+            continue;
+        }
+        leftUsed[candidate.left] = 1;
+        rightUsed[candidate.right] = 1;
+
+        StereoMatch stereoMatch;
+        stereoMatch.leftIndex = candidate.left;
+        stereoMatch.rightIndex = candidate.right;
+        stereoMatch.label = left[candidate.left].label;
+        stereoMatch.disparity = leftRectified[candidate.left].x - rightRectified[candidate.right].x;
+        matches.push_back(stereoMatch);
+
+        leftMatched.push_back(leftRectified[candidate.left]);
+        rightMatched.push_back(rightRectified[candidate.right]);
+    }
+
+    if (matches.empty()) {
+        return;
+    }
+
+    triangulatePoints(leftProjection, rightProjection, leftMatched, rightMatched, homogeneousPoints);   // All pairs of the frame in one call
+
+    Mat points;
+    homogeneousPoints.convertTo(points, CV_64F);
+    for (size_t k = 0; k < matches.size(); k++) {
+        double w = points.at<double>(3, (int)k);
+        Vec3d rectified(points.at<double>(0, (int)k) / w, points.at<double>(1, (int)k) / w, points.at<double>(2, (int)k) / w);
+        Vec3d camera = rectifiedToLeft * rectified;                     // Back to the left camera frame
+        matches[k].position = Point3f((float)camera[0], (float)camera[1], (float)camera[2]);
+    }
+}
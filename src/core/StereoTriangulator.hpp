@@ -0,0 +1,55 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+#include "CalibrationFile.hpp"
+
+/*
+    Depth from a calibrated camera pair. Detections of both cameras are
+    moved into the rectified frame (one batch per camera), where matching
+    points lie on the same image row. Left and right detections with the
+    same label (marker ID or cone class) are paired along those epipolar
+    lines, cheapest row difference first, and every pair of the frame is
+    triangulated in one call.
+*/
+
+struct StereoDetection {                // One detection in the raw (distorted) image of one camera
+    cv::Point2f position;
+    int label;                          // Marker ID or cone class, only equal labels are matched
+};
+
+struct StereoMatch {
+    int leftIndex;
+    int rightIndex;
+    int label;
+    float disparity;                    // [px], in the rectified images
+    cv::Point3f position;               // [m], in the left camera frame
+};
+
+class StereoTriangulator {
+public:
+    explicit StereoTriangulator(const CameraCalibration& calibration);     // The calibration must contain a stereo calibration
+
+    void match(const std::vector<StereoDetection>& left, const std::vector<StereoDetection>& right, std::vector<StereoMatch>& matches);
+
+    float epipolarTolerance = 2.0f;     // Largest row difference between two matched points [px]
+    float minimumDisparity = 0.5f;      // Points further away than this are not triangulated [px]
+
+private:
+    cv::Mat leftCameraMatrix, leftDistortion, leftRectification, leftProjection;
+    cv::Mat rightCameraMatrix, rightDistortion, rightRectification, rightProjection;
+    cv::Matx33d rectifiedToLeft;        // Rotation from the rectified frame back to the left camera frame
+
+    struct Candidate {
+        float cost;
+        int left;
+        int right;
+    };
+
+    std::vector<cv::Point2f> leftRaw, rightRaw, leftRectified, rightRectified, leftMatched, rightMatched;   // Reused from frame to frame
+    std::vector<Candidate> candidates;
+    std::vector<char> leftUsed, rightUsed;
+    cv::Mat homogeneousPoints;
+};
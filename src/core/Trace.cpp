@@ -0,0 +1,189 @@
+#include "Trace.hpp"
+
+#ifdef THREEDVIS_TRACE
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+atomic<bool> tracingActive(false);
+
+namespace {
+
+const uint64_t traceCapacity = 1 << 16;                 // Events kept per thread (1.5 MB), a few minutes of pipeline stages
+
+struct TraceEvent {
+    const char* name;
+    uint64_t startNanoseconds;
+    uint64_t durationNanoseconds;
+};
+
+struct ThreadTrace {                                    // Written by one thread only, each in its own allocation
+    int threadId;
+    string name;                                        // Changed under the registry lock
+    atomic<uint64_t> written{0};                        // Events recorded so far, the newest traceCapacity are in the ring
+    TraceEvent events[traceCapacity];
+};
+
+atomic<bool> dumpRequested(false);                      // Set by the signal handler, only a lock-free flag is safe there
+
+void requestDump(int) {
+    dumpRequested.store(true);
+}
+
+class TraceRegistry {
+public:
+    ~TraceRegistry() {                                  // At exit: every other thread is done
+        if (watcher.joinable()) {
+            stopping.store(true);
+            watcher.join();
+        }
+        if (!path.empty()) {
+            write(path.c_str());
+        }
+    }
+
+    ThreadTrace* add() {
+        lock_guard<mutex> lock(registryMutex);
+        threads.emplace_back(new ThreadTrace());
+        ThreadTrace* trace = threads.back().get();
+        trace->threadId = (int)threads.size();
+        trace->name = "thread " + to_string(trace->threadId);
+        return trace;
+    }
+
+    void rename(ThreadTrace* trace, const char* name) {
+        lock_guard<mutex> lock(registryMutex);
+        trace->name = name;
+    }
+
+    void start(const string& outputPath) {
+        lock_guard<mutex> lock(registryMutex);
+        path = outputPath;
+        origin = traceNanoseconds();
+        if (!watcher.joinable()) {
+            watcher = thread([this]() {                 // Writes the trace when SIGUSR1 comes in
+                while (!stopping.load()) {
+                    this_thread::sleep_for(chrono::milliseconds(50));
+                    if (dumpRequested.exchange(false)) {
+                        write(path.c_str());
+                    }
+                }
+            });
+        }
+    }
+
+    bool write(const char* outputPath);
+
+private:
+    mutex registryMutex;
+    vector<unique_ptr<ThreadTrace>> threads;            // Never freed before exit, threads that ended keep their events
+    string path;
+    uint64_t origin = 0;
+    thread watcher;
+    atomic<bool> stopping{false};
+};
+
+TraceRegistry& registry() {
+    static TraceRegistry instance;
+    return instance;
+}
+
+thread_local ThreadTrace* currentThread = nullptr;
+
+ThreadTrace* threadTrace() {
+    if (currentThread == nullptr) {
+        currentThread = registry().add();               // Once per thread
+    }
+    return currentThread;
+}
+
+}
+
+bool TraceRegistry::write(const char* outputPath) {
+
+    lock_guard<mutex> lock(registryMutex);
+
+    FILE* out = fopen(outputPath, "w");
+    if (out == nullptr) {
+        cout << "Could not write the trace to " << outputPath << endl;
+        return false;
+    }
+
+    int pid = (int)getpid();
+    vector<TraceEvent> copied;
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+
+    for (const unique_ptr<ThreadTrace>& trace : threads) {
+        fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", pid, trace->threadId, trace->name.c_str());
+        first = false;
+
+        uint64_t end = trace->written.load(memory_order_acquire);
+        uint64_t begin = end > traceCapacity ? end - traceCapacity : 0;
+        copied.clear();
+        for (uint64_t i = begin; i < end; i++) {        // The thread keeps recording meanwhile
+            copied.push_back(trace->events[i % traceCapacity]);
+        }
+
+        atomic_thread_fence(memory_order_acquire);                              // The copy happens before the second check
+        uint64_t overwritten = trace->written.load(memory_order_relaxed);         // Events of the ring rewritten during the copy are dropped
+        uint64_t valid = overwritten >= traceCapacity ? overwritten - traceCapacity + 1 : 0;   // The slot of event overwritten may be half written already
+        for (uint64_t i = max(begin, valid); i < end; i++) {
+            const TraceEvent& event = copied[i - begin];
+            if (event.startNanoseconds < origin) {
+                continue;
+            }
+            fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", event.name, pid, trace->threadId,
+                    (event.startNanoseconds - origin) / 1000.0, event.durationNanoseconds / 1000.0);
+        }
+    }
+
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    return true;
+}
+
+void recordTraceEvent(const char* name, uint64_t startNanoseconds, uint64_t endNanoseconds) {
+
+    ThreadTrace* trace = threadTrace();
+    uint64_t n = trace->written.load(memory_order_relaxed);                     // Only this thread writes it
+    trace->events[n % traceCapacity] = {name, startNanoseconds, endNanoseconds - startNanoseconds};
+    trace->written.store(n + 1, memory_order_release);
+}
+
+void setTraceThreadName(const char* name) {
+
+    registry().rename(threadTrace(), name);
+}
+
+void startTracing(const char* tool) {
+
+    const char* path = getenv("THREEDVIS_TRACE_FILE");
+    string outputPath = path != nullptr ? path : string(tool) + ".trace.json";
+
+    registry().start(outputPath);
+    setTraceThreadName("main");
+    signal(SIGUSR1, requestDump);
+    tracingActive.store(true);
+
+    cout << "Tracing to " << outputPath << " (kill -USR1 " << getpid() << " writes it now)" << endl;
+}
+
+bool writeTrace(const char* path) {
+
+    return registry().write(path);
+}
+
+#endif
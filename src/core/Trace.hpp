@@ -0,0 +1,70 @@
+#pragma once
+
+/*
+    Scoped trace points, written as a Chrome trace (open it in
+    chrome://tracing or ui.perfetto.dev) to see which stage, on which
+    thread, took how long on every frame.
+
+        TRACE_START("aruco");       // In main: trace to aruco.trace.json
+        TRACE_THREAD("decode");     // Name of the calling thread in the trace
+        TRACE_SCOPE("detection");   // From here to the end of the scope
+
+    Every thread records into its own buffer: a ring of the newest events
+    that only this thread writes, so recording takes no lock and shares no
+    cache line with the other threads. A trace point costs two clock reads
+    and one store. The trace is written when the program exits, and on
+    SIGUSR1 (kill -USR1 <pid>) while it runs. THREEDVIS_TRACE_FILE changes
+    where it goes.
+
+    Tracing is compiled in with the THREEDVIS_TRACE CMake option. Without
+    it, the macros expand to nothing and cost nothing.
+*/
+
+#ifdef THREEDVIS_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+extern std::atomic<bool> tracingActive;     // Set by startTracing, trace points before it are not recorded
+
+inline uint64_t traceNanoseconds() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void recordTraceEvent(const char* name, uint64_t startNanoseconds, uint64_t endNanoseconds);   // name must outlive the program (a literal)
+void setTraceThreadName(const char* name);
+void startTracing(const char* tool);        // Writes <tool>.trace.json at exit and on SIGUSR1
+bool writeTrace(const char* path);          // What the buffers hold now
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name(name), start(tracingActive.load(std::memory_order_relaxed) ? traceNanoseconds() : 0) {}
+    ~TraceScope() {
+        if (start != 0) {
+            recordTraceEvent(name, start, traceNanoseconds());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;                         // 0 when tracing is off
+};
+
+#define THREEDVIS_TRACE_JOIN_(a, b) a##b
+#define THREEDVIS_TRACE_JOIN(a, b) THREEDVIS_TRACE_JOIN_(a, b)
+
+#define TRACE_SCOPE(name) TraceScope THREEDVIS_TRACE_JOIN(traceScope, __LINE__)(name)
+#define TRACE_THREAD(name) setTraceThreadName(name)
+#define TRACE_START(tool) startTracing(tool)
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD(name) ((void)0)
+#define TRACE_START(tool) ((void)0)
+
+#endif
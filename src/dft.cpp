@@ -1,91 +1,131 @@
 #include <opencv2/opencv.hpp>
 #include <stdint.h>
 
-using namespace std;
-using namespace cv;
+#include <iostream>
+#include <memory>
 
-void takeDFT(Mat& source, Mat& destination) {
+#include "core/Fourier.hpp"
+#include "core/FrameSource.hpp"
+#include "core/LatencyStats.hpp"
+#include "core/Trace.hpp"
 
-    Mat originalComplex[2] ={source, Mat::zeros(source.size(), CV_32F)};    // Make a matrix with the float values and zeros
-    Mat dftReady;                                                           // Define matrix that we will use to compute the DFT with
-    merge(originalComplex, 2, dftReady);                                    // Merge the two matrices
+using namespace std;
+using namespace cv;
 
-    dft(dftReady, destination, DFT_COMPLEX_OUTPUT);                         // Compute the DFT
+void showDFT(const DftPlan& plan, Mat& dftMagnitude) {
 
-}
+    plan.logMagnitude(dftMagnitude);                                // log(1 + magnitude), straight from the complex spectrum
 
-void recenterDFT (Mat& source) {                                // Recenter DFT function
+    normalize(dftMagnitude, dftMagnitude, 0, 1, NORM_MINMAX);       // Normalize dftMagnitude with 0 as minimum value and 1 as maximum value
 
-    /*
-        We change around the quadrants of the DFT image so that the high
-        frequency data is at the edges and the low frequency data is at
-        the center (this is usually how DFT images are presented).
-    */
+    recenterDFT(dftMagnitude);
 
-    int centerX = source.cols/2;                                // Define center column of image
-    int centerY = source.rows/2;                                // Define center row of image
+    imshow("DFT", dftMagnitude);                                    // Show dftMagnitude in Window
+}
 
-    Mat q1(source, Rect(0, 0, centerX, centerY));               // Define quadrant 1 from top left to center point of image
-    Mat q2(source, Rect(centerX, 0, centerX, centerY));         // Define quadrant 2 from top middle to center row of image
-    Mat q3(source, Rect(0, centerY, centerX, centerY));         // Define quadrant 3 from middle row to bottom center point of image
-    Mat q4(source, Rect(centerX, centerY, centerX, centerY));   // Define quadrant 4 from middle point to bottom right point of image
+bool configureFilter(const CommandLineParser& parser, FrequencyFilter& filter) {   // Set up the filter chosen on the command line
+
+    String type = parser.get<String>("filter");
+
+    if (type == "lowpass") {
+        filter.setLowPass(parser.get<double>("high"));
+    } else if (type == "bandpass") {
+        filter.setBandPass(parser.get<double>("low"), parser.get<double>("high"));
+    } else if (type == "template") {
+        Mat templ = imread(parser.get<String>("template"), IMREAD_GRAYSCALE);
+        if (templ.empty()) {
+            cout << "Could not read the template " << parser.get<String>("template") << endl;
+            return false;
+        }
+        filter.setTemplate(templ);
+    } else if (type != "none") {
+        cout << "Unknown filter " << type << ", use none, lowpass, bandpass or template" << endl;
+        return false;
+    }
+    return true;
+}
 
-    Mat swapMap;            // Define swapMap matrix for swapping the quadrants (temporary variable for placing the quadrant we are moving)
+void showFiltered(const FrequencyFilter& filter, const Mat& filtered, Mat& display) {    // Filtered image, or correlation map with its peak
 
-    q1.copyTo(swapMap);     // Copy quadrant 1 to swapMap
-    q4.copyTo(q1);          // Move quadrant 4 to where quadrant 1 was
-    swapMap.copyTo(q4);     // Move quadrant 1 to where quadrant 4 was
+    normalize(filtered, display, 0, 1, NORM_MINMAX);
 
-    q2.copyTo(swapMap);     // Copy quadrant 2 to swapMap
-    q3.copyTo(q2);          // Move quadrant 3 to where quadrant 2 was
-    swapMap.copyTo(q3);     // Move quadrant 2 to where quadrant 3 was
+    if (filter.mode() == FrequencyFilter::CORRELATION) {
+        Point peak;
+        minMaxLoc(filtered, nullptr, nullptr, nullptr, &peak);     // Top left corner of the best template position
+        circle(display, peak, 8, Scalar::all(1), 2);
+    }
 
+    imshow("Filtered", display);
 }
 
-void showDFT(Mat& source) {
-
-    Mat splitArray[2] = {Mat::zeros(source.size(), CV_32F), Mat::zeros(source.size(), CV_32F)}; 
+int main(int argv, char** argc) {
 
-    split(source, splitArray);
+    const String keys =
+        "{help h   |                   | print this message }"
+        "{image    | ../images/bug.jpg | image to transform }"
+        "{video    |                   | filter every frame of this video (session or camera index) instead of the image }"
+        "{filter   | none              | none, lowpass, bandpass or template }"
+        "{low      | 0.05              | band-pass lower cutoff, fraction of the Nyquist frequency }"
+        "{high     | 0.2               | low-pass and band-pass upper cutoff, fraction of the Nyquist frequency }"
+        "{template |                   | image to correlate the frames with (--filter=template) }";
 
-    Mat dftMagnitude;
+    CommandLineParser parser(argv, argc, keys);
+    if (parser.has("help")) {
+        parser.printMessage();
+        return 0;
+    }
 
-    magnitude(splitArray[0], splitArray[1], dftMagnitude);
+    TRACE_START("dft");                                         // Only with the THREEDVIS_TRACE build option
 
-    dftMagnitude += Scalar::all(1);                                 // Add 1 to add values in dftMagnitude
-    log(dftMagnitude, dftMagnitude);                                // Take the log of dftMagnitude
+    FrequencyFilter filter;
+    if (!configureFilter(parser, filter)) {
+        return -1;
+    }
 
-    normalize(dftMagnitude, dftMagnitude, 0, 1, NORM_MINMAX);       // Normalize dftMagnitude with 0 as minimum value and 1 as maximum value
-
-    recenterDFT(dftMagnitude);
+    Mat dftMagnitude, filtered, display;
 
-    imshow("DFT", dftMagnitude);                                    // Show dftMagnitude in Window
-    waitKey(0);
-}
+    if (!parser.has("video")) {
+        Mat original = imread(parser.get<String>("image"), IMREAD_GRAYSCALE);  // Import image as greyscale (we cannot perform a DFT on a multi-channel image!!)
+        if (original.empty()) {
+            cout << "Could not read " << parser.get<String>("image") << endl;
+            return -1;
+        }
 
-void invertDFT(Mat& source, Mat& destination) {                             // Function to invert the DFT to get original image                                                        // Define inverse matrix
+        filter.apply(original, filtered);                           // Forward DFT, filter, inverse DFT (just the round trip with --filter=none)
 
-    dft(source, destination, DFT_INVERSE | DFT_REAL_OUTPUT | DFT_SCALE);    // call dft with the flags to invert, only retain the real ouput value, and scale the image.
-}
+        showDFT(filter.plan(), dftMagnitude);                       // Call function to show DFT
+        showFiltered(filter, filtered, display);                    // Show inverted DFT image (the original image when there is no filter)
+        waitKey(0);
 
-int main(int argv, char** argc) {
+        return 0;
+    }
 
-    Mat original = imread("../images/bug.jpg", IMREAD_GRAYSCALE);   // Import image as greyscale (we cannot perform a DFT on a multi-channel image!!)
+    unique_ptr<FrameSource> frames = openFrameSource(parser.get<String>("video"));     // Video file, session or camera index
+    if (!frames) {
+        return -1;
+    }
 
-    Mat originalFloat;                                              // Define matrix so that we can convert our matrix to a float
-    original.convertTo(originalFloat, CV_32FC1, 1.0/255.0);         // Convert original matrix to float and normalize the values in the matrix
+    Mat frame, grey;
+    double timestamp;
+    LatencyHistogram filtering;
 
-    Mat dftOfOriginal;                                              // Define the output image of the DFT
+    while (frames->read(frame, timestamp)) {
+        cvtColor(frame, grey, COLOR_BGR2GRAY);
 
-    takeDFT(originalFloat, dftOfOriginal);                          // Call function to compute DFT
-    showDFT(dftOfOriginal);                                         // Call function to show DFT
+        {
+            ScopedLatency timer(filtering);
+            filter.apply(grey, filtered);                           // Buffers are reused from frame to frame
+        }
 
-    Mat invertedDFT;                                                // Define inverted DFT data matrix
+        showDFT(filter.plan(), dftMagnitude);
+        showFiltered(filter, filtered, display);
 
-    invertDFT(dftOfOriginal, invertedDFT);                          // Call invert DFT function
+        if (waitKey(1) == 27) {                                     // Escape stops the video
+            break;
+        }
+    }
 
-    imshow("Inverted DFT Result", invertedDFT);                     // Show inverted DFT image (which will be the original image)
-    waitKey(0);
+    cout << "Frequency filter: " << filtering.count() << " frames, p50 " << filtering.percentileMilliseconds(0.5) << " ms, p99 " << filtering.percentileMilliseconds(0.99) << " ms, max " << filtering.maxMilliseconds() << " ms" << endl;
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,185 @@
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include <opencv2/aruco.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+
+#include "core/CalibrationFile.hpp"
+#include "core/ConeSegmentation.hpp"
+#include "core/FrameSource.hpp"
+#include "core/LatencyStats.hpp"
+#include "core/RingBuffer.hpp"
+#include "core/StereoTriangulator.hpp"
+
+using namespace std;
+using namespace cv;
+
+/*
+    3D positions from two cameras. Each camera has its own thread that grabs
+    and detects (aruco markers or cones), so both streams are processed in
+    parallel. The main thread pairs the two streams by capture timestamp,
+    matches the detections along the epipolar lines and triangulates them:
+    depth costs one matching step on top of the slowest camera.
+*/
+
+const size_t sideQueueCapacity = 4;                     // Frames waiting for their partner before the oldest is dropped
+
+struct SideResult {                                     // Detections of one camera for one frame
+    int index = -1;
+    double timestampMilliseconds = 0.0;
+    vector<StereoDetection> detections;
+};
+
+void runSide(const string& source, bool detectCones, RingBuffer<SideResult>& output, LatencyHistogram& detectionLatency, const atomic<bool>& stopRequested) {  // Grab and detect on one camera
+
+    unique_ptr<FrameSource> frames = openFrameSource(source);          // Live cameras are grabbed on their own thread and carry driver timestamps
+
+    if (!frames) {
+        output.close();
+        return;
+    }
+
+    Ptr<aruco::DetectorParameters> parameters = aruco::DetectorParameters::create();
+    Ptr<aruco::Dictionary> markerDictionary = aruco::getPredefinedDictionary(aruco::PREDEFINED_DICTIONARY_NAME::DICT_4X4_50);
+    ConeSegmenter coneSegmenter;
+
+    Mat frame;
+    vector<int> markerIDs;
+    vector<vector<Point2f>> markerCorners;
+    vector<ConeBlob> coneBlobs;
+    double timestamp;
+
+    for (int nFrame = 0; !stopRequested.load() && frames->read(frame, timestamp); nFrame++) {
+        SideResult result;
+        result.index = nFrame;
+        result.timestampMilliseconds = timestamp;                       // Steady clock for cameras, media time for files, so that both pair up
+
+        {
+            ScopedLatency timer(detectionLatency);
+            if (detectCones) {
+                coneSegmenter.segment(frame, coneBlobs);
+                for (const ConeBlob& blob : coneBlobs) {
+                    result.detections.push_back({blob.centroid, (int)blob.coneClass});
+                }
+            } else {
+                aruco::detectMarkers(frame, markerDictionary, markerCorners, markerIDs, parameters);
+                for (size_t i = 0; i < markerIDs.size(); i++) {
+                    Point2f center = (markerCorners[i][0] + markerCorners[i][1] + markerCorners[i][2] + markerCorners[i][3]) * 0.25f;
+                    result.detections.push_back({center, markerIDs[i]});
+                }
+            }
+        }
+
+        output.pushDropOldest(move(result));
+    }
+    output.close();
+}
+
+int main(int argv, char** argc) {
+
+    const String keys =
+        "{help h      |                          | print this message }"
+        "{left        | ../videos/left.mov       | left camera (video file or camera index) }"
+        "{right       | ../videos/right.mov      | right camera (video file or camera index) }"
+        "{calibration | ../cameraCalibration.bin | stereo calibration written by calibrate --stereo }"
+        "{cones       |                          | triangulate cone blobs instead of aruco markers }"
+        "{sync        | 8                        | largest timestamp difference between two paired frames [ms] }"
+        "{output o    |                          | write the 3D positions as CSV to this file instead of stdout }";
+
+    CommandLineParser parser(argv, argc, keys);
+    if (parser.has("help")) {
+        parser.printMessage();
+        return 0;
+    }
+
+    MappedCalibration calibrationFile;
+    if (!calibrationFile.open(parser.get<String>("calibration"))) {
+        cout << calibrationFile.error() << ", exiting program..." << endl;
+        return -1;
+    }
+    if (calibrationFile.calibration().stereo.empty()) {
+        cout << parser.get<String>("calibration") << " has no stereo calibration, run calibrate --stereo first." << endl;
+        return -1;
+    }
+
+    StereoTriangulator triangulator(calibrationFile.calibration());
+    double syncTolerance = parser.get<double>("sync");
+    bool detectCones = parser.has("cones");
+
+    ofstream outputFile;
+    ostream* out = &cout;
+    if (!parser.get<String>("output").empty()) {
+        outputFile.open(parser.get<String>("output"));
+        if (!outputFile) {
+            cout << "Could not write " << parser.get<String>("output") << endl;
+            return -1;
+        }
+        out = &outputFile;
+    }
+    *out << "frame,timestampMs,label,x,y,z" << endl;
+
+    RingBuffer<SideResult> leftQueue(sideQueueCapacity), rightQueue(sideQueueCapacity);
+    LatencyHistogram leftDetection, rightDetection, matching;
+    atomic<bool> stopRequested(false);
+
+    thread leftThread(runSide, parser.get<String>("left"), detectCones, ref(leftQueue), ref(leftDetection), cref(stopRequested));     // Both cameras in parallel
+    thread rightThread(runSide, parser.get<String>("right"), detectCones, ref(rightQueue), ref(rightDetection), cref(stopRequested));
+
+    SideResult left, right;
+    bool haveLeft = false, haveRight = false;
+    int pairs = 0, unpaired = 0;
+    vector<StereoMatch> matches;
+
+    while (true) {                                                      // Pair the frames by timestamp
+        if (!haveLeft) {
+            haveLeft = leftQueue.waitPop(left);
+        }
+        if (!haveRight) {
+            haveRight = rightQueue.waitPop(right);
+        }
+        if (!haveLeft || !haveRight) {                                  // One of the streams ended
+            break;
+        }
+
+        double difference = left.timestampMilliseconds - right.timestampMilliseconds;
+        if (fabs(difference) > syncTolerance) {                         // Not taken at the same time: drop the older frame and wait for its partner
+            if (difference < 0) {
+                haveLeft = false;
+            } else {
+                haveRight = false;
+            }
+            unpaired++;
+            continue;
+        }
+
+        {
+            ScopedLatency timer(matching);
+            triangulator.match(left.detections, right.detections, matches);
+        }
+
+        for (const StereoMatch& match : matches) {
+            *out << left.index << ',' << left.timestampMilliseconds << ',' << match.label << ','
+                 << match.position.x << ',' << match.position.y << ',' << match.position.z << '\n';
+        }
+
+        pairs++;
+        haveLeft = haveRight = false;
+    }
+
+    stopRequested.store(true);
+    leftThread.join();
+    rightThread.join();
+    out->flush();
+
+    cerr << pairs << " frame pairs triangulated, " << unpaired << " frames without a partner, " << leftQueue.dropped() + rightQueue.dropped() << " dropped" << endl;
+    cerr << "Detection p99: left " << leftDetection.percentileMilliseconds(0.99) << " ms, right " << rightDetection.percentileMilliseconds(0.99) << " ms" << endl;
+    cerr << "Matching and triangulation p99: " << matching.percentileMilliseconds(0.99) << " ms" << endl;
+
+    return 0;
+}